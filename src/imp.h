@@ -35,15 +35,21 @@
    -- vertical or horizontal stack options
    -- position (left/right +  up/down, inside/outside?)
 
-   -- log scale for either axes individually
-   
-   - highlight individual points desmos style
    - return to original view after panning/zooming 
 */
 
 
+#include <stddef.h>
+#include <string.h>
 #include "third_party/HandmadeMath.h"
 
+/* NOTE(lcf): HandmadeMath only checks for SSE, the f64 paths need SSE2. Everything that uses
+   these has a scalar fallback. */
+#if defined(HANDMADE_MATH__USE_SSE) && (defined(__SSE2__) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define IMP_USE_SSE2 1
+#endif
+
 /* TODO(lcf): prefix everything with an imp_ namespace */
 /* TODO(lcf): we can remove these typedefs when the jam is over. just for my familiarity */
 typedef unsigned long u64;
@@ -76,6 +82,7 @@ str imp_str(char *s) {
 #endif
 
 #define MAX(a,b) (((a) > (b))? (a) : (b))
+#define MIN(a,b) (((a) < (b))? (a) : (b))
 #define ASSERT(c) do { if (!(c)) { (*(int*)0=0); }} while (0);
 #define PCAST(type, p) (*((type*)&p))
 
@@ -96,13 +103,26 @@ union Rect {
     struct { Vec2 pos;  Vec2 size; };
 };
 
+/* NOTE(lcf): a view in data units. Plot views are f32 relative to the plot origin, see
+   imp_view64. */
+typedef union Rect64 Rect64;
+union Rect64 {
+    struct { f64 x, y, w, h; };
+};
+
 typedef struct Data Data;
 struct Data {
     u32 flags;
     u16 marker_type;
     u8 fill_type;
+    /* NOTE(lcf): bytes per value, 0 or 4 for f32, 8 if x/y/z actually point at f64. Only the
+       bounds, stats, range search, hover label and imp_shown_data read the raw values. Drawing
+       and hit testing read the f32 copy from imp_shown_data, so commands never carry f64. */
     u8 data_size;
     s32 n;
+    /* NOTE(lcf): bump when the contents of x/y/z change. Appending points only needs n to grow,
+       backends use this to re-upload just the new tail of a series. */
+    u32 version;
     f32 *x;
     f32 *y;
     f32 *z;
@@ -131,14 +151,170 @@ enum {
 #define IMP_PLOT_DRAW_ALL_GRID (IMP_PLOT_DRAW_GRID_XY | IMP_PLOT_DRAW_GRID_YZ | IMP_PLOT_DRAW_GRID_ZX)
 #define IMP_PLOT_DRAW_ALL_3D (IMP_PLOT_DRAW_ALL_AXES | IMP_PLOT_DRAW_ALL_GRID)
 #define IMP_PLOT_DRAW_ALL_2D (IMP_PLOT_DRAW_AXIS_X | IMP_PLOT_DRAW_AXIS_Y | IMP_PLOT_DRAW_GRID_XY)
+/* NOTE(lcf): view.h is left alone instead of following the screen aspect, and each axis
+   gets its own grid steps */
+#define IMP_PLOT_FREE_ASPECT (1 << 8)
+/* NOTE(lcf): label the visible part of the first series with its min/max/mean/rms */
+#define IMP_PLOT_DRAW_STATS (1 << 9)
+/* NOTE(lcf): values on a time axis are seconds since 1970-01-01 UTC, ticks fall on calendar
+   steps and are labelled as times and dates */
+#define IMP_PLOT_TIME_X (1 << 10)
+#define IMP_PLOT_TIME_Y (1 << 11)
 
 #define IMP_MAX_DATA 8
+
+/* NOTE(lcf): built lazily per series for nearest point queries, and rebuilt when the
+   series version or n changes. Series with sorted x are binary searched, anything else
+   (or sorted x too dense to scan) goes through a uniform grid of point indices. */
+typedef struct DataIndex DataIndex;
+struct DataIndex {
+    u32 version;
+    s32 n;
+    b32 built;
+    b32 sorted_x;
+    b32 has_grid;
+    Rect bounds;
+    s32 grid_w;
+    s32 grid_h;
+    s32 *cell_start;
+    s32 *cell_points;
+    s32 cell_capacity;
+    s32 point_capacity;
+};
+
+/* NOTE(lcf): min/max of the finite values of each axis of a series, kept per version. If only
+   n grew since the last scan just the new tail is read. */
+typedef struct DataBounds DataBounds;
+struct DataBounds {
+    u32 version;
+    s32 n;
+    b32 built;
+    f64 min[3];
+    f64 max[3];
+};
+
+/* NOTE(lcf): count, sum, sum of squares, min and max of the finite y values in a range */
+typedef struct DataStats DataStats;
+struct DataStats {
+    s32 count;
+    f64 sum;
+    f64 sum2;
+    f32 min;
+    f32 max;
+};
+
+/* NOTE(lcf): DataStats of blocks of IMP_STATS_BLOCK points in an implicit segment tree, node k
+   has children 2k and 2k+1 and block b is leaf leaves + b. Queries take whole blocks from the
+   tree and scan at most two partial ones, which keeps the tree to 1-2 bytes a point.
+   Built on the first query, and only the tail is redone if just n grew. */
+#define IMP_STATS_BLOCK 64
+
+typedef struct DataTree DataTree;
+struct DataTree {
+    u32 version;
+    s32 n;
+    b32 built;
+    s32 blocks;
+    s32 leaves;
+    DataStats *node;
+};
+
+/* NOTE(lcf): ring buffer for live series. Samples are written twice, at i and i + capacity,
+   so the newest n are always contiguous and a Data can point straight into x and y.
+   min_queue/max_queue are monotonic deques of sample numbers covering the last window x
+   units: values increase (decrease) from the front, so the window's y range is at their
+   fronts and each sample is pushed and popped at most once. */
+typedef struct Stream Stream;
+struct Stream {
+    s32 capacity;
+    s32 n;
+    s64 count;
+    f32 *x;
+    f32 *y;
+    f64 window;
+    s64 *min_queue;
+    s64 *max_queue;
+    s32 min_head, min_len;
+    s32 max_head, max_len;
+    s64 data_count;
+};
+
+/* NOTE(lcf): per axis scale. Data, view and mouse of a scaled axis are all in scaled units.
+   log10 of values <= 0 is NaN and those points are left out. Symlog is sign(v)*log10(1 + |v|/C)
+   with C = symlog_linear, so it is close to linear within C of zero. */
+enum {
+    IMP_SCALE_LINEAR = 0,
+    IMP_SCALE_LOG10,
+    IMP_SCALE_SYMLOG,
+};
+
+/* NOTE(lcf): f32 copy of a series with its scaled axes (and f64 axes) converted, kept per version
+   like DataBounds. generation is bumped on every full rebuild and used as the version of the
+   shown series, so caches downstream only redo the tail when points are appended. */
+typedef struct ScaledData ScaledData;
+struct ScaledData {
+    u32 version;
+    s32 n;
+    b32 built;
+    u32 generation;
+    f64 origin_x;
+    f64 origin_y;
+    s32 capacity;
+    f32 *x;
+    f32 *y;
+};
+
+/* NOTE(lcf): grid lines and labels of a log, symlog or time axis in (scaled) data units. Only
+   rebuilt when the range of decades or time steps around the view, or the step between labels,
+   change, so panning within it doesn't format anything. Labels point into text. */
+#define IMP_MAX_TICKS 256
+#define IMP_TICK_TEXT_SIZE 2048
+
+typedef struct AxisTicks AxisTicks;
+struct AxisTicks {
+    b32 time;
+    s32 scale;
+    f32 linear;
+    s64 first;
+    s64 last;
+    s32 step;
+    b32 built;
+    s32 count;
+    f64 pos[IMP_MAX_TICKS];
+    u8 major[IMP_MAX_TICKS];
+    str label[IMP_MAX_TICKS];
+    /* NOTE(lcf): which step a labelled tick is, counted from a fixed origin and not from the
+       start of the cache, so thinning labels doesn't change when the cache moves */
+    s64 number[IMP_MAX_TICKS];
+    s32 text_pos;
+    char text[IMP_TICK_TEXT_SIZE];
+};
+
 typedef struct Plot Plot;
 struct Plot {
     Rect screen;
     Rect view;
     Rect target_view;
+    Rect view_velocity;
     Data data[IMP_MAX_DATA];
+    DataIndex data_index[IMP_MAX_DATA];
+    DataBounds data_bounds[IMP_MAX_DATA];
+    DataTree data_tree[IMP_MAX_DATA];
+    ScaledData scaled[IMP_MAX_DATA];
+    /* NOTE(lcf): IMP_SCALE_* of each axis, symlog_linear <= 0 means 1 */
+    s32 scale_x;
+    s32 scale_y;
+    f32 symlog_linear;
+    u32 scale_key;
+    /* NOTE(lcf): view, target_view, mouse and shown data of a linear axis are relative to its
+       origin. It follows the view around so f32 keeps resolving it on large offset data like
+       timestamps, while the data itself can stay f64. */
+    f64 origin_x;
+    f64 origin_y;
+    AxisTicks ticks[2];
+    /* NOTE(lcf): series and point under the mouse, hover_series is -1 if none */
+    s32 hover_series;
+    s32 hover_index;
 
     HMM_Vec3 camera_pos;
     HMM_Vec3 camera_target;
@@ -152,19 +328,35 @@ struct Plot {
     Vec2 mouse;
     Vec2 last_mouse;
     Vec2 drag;
+    /* NOTE(lcf): set while the view is following a mouse drag, see imp_late_pan_offset */
+    b32 dragging;
 
     str title;
     ID id;
     s32 next;
+    /* NOTE(lcf): byte offsets into command_buffer */
     s32 first_command;
     s32 last_command;
     s32 next_command;
+
+    /* NOTE(lcf): hash of this plot's commands, changed is set if it differs from last frame */
+    u32 command_hash;
+    b32 changed;
+    /* NOTE(lcf): set while view is still moving toward target_view */
+    b32 animating;
 };
 
+/* NOTE(lcf): commands are packed back to back in the command buffer. Each one
+   starts with a BaseCommand header whose size is the full command size in bytes
+   (rounded up to IMP_COMMAND_ALIGN), so a reader can step over any command
+   without knowing its type. */
+#define IMP_COMMAND_ALIGN 8
+
 typedef struct BaseCommand BaseCommand;
 struct BaseCommand {
-    s16 type;
-    s16 plot;
+    u16 type;
+    u16 size;
+    u16 plot;
     imp_Color color;
 };
 
@@ -188,6 +380,41 @@ struct DataCommand {
     Data data;
 };
 
+/* NOTE(lcf): consecutive draw_rect calls with the same color are merged into one of these */
+typedef struct RectListCommand RectListCommand;
+struct RectListCommand {
+    BaseCommand base;
+    s32 count;
+    Rect rects[];
+};
+
+/* NOTE(lcf): count evenly spaced 1 pixel lines. For IMP_GRID_VERTICAL lines, origin is the
+   top of the first line and step is along x. For IMP_GRID_HORIZONTAL, origin is the left
+   end and step is along y. */
+typedef struct GridCommand GridCommand;
+struct GridCommand {
+    BaseCommand base;
+    Vec2 origin;
+    f32 step;
+    f32 length;
+    s32 count;
+    s32 orientation;
+};
+
+enum {
+    IMP_GRID_VERTICAL = 0,
+    IMP_GRID_HORIZONTAL,
+};
+
+/* NOTE(lcf): a hovered data point, at screen in the series color */
+typedef struct HighlightCommand HighlightCommand;
+struct HighlightCommand {
+    BaseCommand base;
+    Vec2 screen;
+    s32 series;
+    s32 index;
+};
+
 typedef struct CustomCommand CustomCommand;
 struct CustomCommand {
     BaseCommand base;
@@ -200,15 +427,24 @@ enum {
     IMP_COMMAND_TEXT,
     IMP_COMMAND_DATA,
     IMP_COMMAND_CUSTOM, 
+    IMP_COMMAND_GRID,
+    IMP_COMMAND_RECT_LIST,
+    IMP_COMMAND_HIGHLIGHT,
     IMP_COMMAND_MAX
 };
+/* NOTE(lcf): only ever used through a pointer into the command buffer, the
+   storage behind it is just as large as the command it holds. */
 typedef union Command Command;
 union Command {
-    s16 type;
+    u16 type;
     BaseCommand base;
     RectCommand rect;
+    RectListCommand rect_list;
     TextCommand text;
     DataCommand data;
+    GridCommand grid;
+    HighlightCommand highlight;
+    CustomCommand custom;
 };
 
 typedef struct Inputs Inputs;
@@ -218,14 +454,29 @@ struct Inputs {
     s32 mouse_down;
     Vec2 last_mouse;
     s32 mouse_pressed;
+    /* NOTE(lcf): seconds since last frame, used for view animation */
+    f32 dt;
 };
 
 /* NOTE(lcf): must be power of 2 */
 /* #define IMP_MAX_PLOTS (2 << 5) */
 #define IMP_MAX_PLOTS 4
 
-#define IMP_COMMAND_BUFFER_SIZE 0x1000
+/* NOTE(lcf): size in bytes */
+#define IMP_COMMAND_BUFFER_SIZE 0x20000
 #define IMP_CHAR_BUFFER_SIZE (0x4000)
+
+/* NOTE(lcf): coarse occupancy of the plot being ended, one row of bits per row of cells. Labels
+   claim the cells they cover and ones landing on claimed cells aren't drawn. */
+#define IMP_LABEL_GRID_SIZE 64
+typedef struct LabelGrid LabelGrid;
+struct LabelGrid {
+    Rect screen;
+    f32 cell_w;
+    f32 cell_h;
+    u64 rows[IMP_LABEL_GRID_SIZE];
+};
+
 typedef struct Context Context;
 struct Context {
     Inputs input;
@@ -235,18 +486,23 @@ struct Context {
     s32 text_height;
 
     s32 command_pos;
+    s32 prev_command;
     s32 char_pos;
 
     u64 counter;
+    /* NOTE(lcf): set if any plot changed this frame, backends can skip redrawing otherwise */
+    b32 changed;
+    b32 animating;
     ID next_id;
     ID current_plot;
     Plot *first_plot;
     Plot *prev_plot;
 
-    Command command_buffer[IMP_COMMAND_BUFFER_SIZE];
+    _Alignas(IMP_COMMAND_ALIGN) u8 command_buffer[IMP_COMMAND_BUFFER_SIZE];
     char char_buffer[IMP_CHAR_BUFFER_SIZE];
     ID plot_collision[IMP_MAX_PLOTS];
     Plot plot[IMP_MAX_PLOTS];
+    LabelGrid label_grid;
 };
 
 /* 32bit fnv-1a hash */
@@ -259,6 +515,15 @@ static void hash(u32 *hash, const void *data, s32 size) {
     }
 }
 
+/* fnv-1a over whole words, for hashing command ranges */
+static void hash_words(u32 *hash, const void *data, s32 size) {
+    const u32 *p = data;
+    for (s32 i = 0; i < size/4; i++) {
+        *hash ^= p[i];
+        *hash *= 16777619;
+    }
+}
+
 Plot *current_plot(Context *imp) {
     return imp->plot + (imp->current_plot & (IMP_MAX_PLOTS-1));
 }
@@ -349,10 +614,18 @@ void free_plot(Context *imp, ID plot_id) {
     }
 }
 
-void push_command(Context *imp, Command cmd) {
-    ASSERT(imp->command_pos+1 < IMP_COMMAND_BUFFER_SIZE);
-    cmd.base.plot = imp->current_plot;
-    imp->command_buffer[imp->command_pos++] = cmd;
+Command *push_command(Context *imp, s32 type, s32 size) {
+    size = (size + IMP_COMMAND_ALIGN-1) & ~(IMP_COMMAND_ALIGN-1);
+    ASSERT(size <= 0xFFFF);
+    ASSERT(imp->command_pos + size <= IMP_COMMAND_BUFFER_SIZE);
+    Command *cmd = (Command *)(imp->command_buffer + imp->command_pos);
+    imp->prev_command = imp->command_pos;
+    memset(cmd, 0, size); /* NOTE(lcf): keeps padding stable for command hashing */
+    cmd->base.type = type;
+    cmd->base.size = size;
+    cmd->base.plot = imp->current_plot;
+    imp->command_pos += size;
+    return cmd;
 }
 
 #include <stdarg.h>
@@ -380,6 +653,145 @@ s32 str_eq(str a, str b) {
          || (memcmp(a.str, b.str, a.len) == 0));
 }
 
+/* NOTE(lcf): tick labels are written digit by digit instead of going through the printf parser.
+   The digits a label needs follow from the step between ticks, so they're worked out once per
+   axis, and trailing zeros are trimmed to give the shortest label that tells ticks apart. */
+typedef struct TickFormat TickFormat;
+struct TickFormat {
+    s32 step_exponent; /* power of ten of the last digit that changes between ticks */
+    b32 scientific;
+};
+
+static const char imp_digit_pairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+static const f64 imp_pow10_f64[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/* v*10^k, exact for the table's powers since they're exact in f64 */
+static f64 scale_pow10(f64 v, s32 k) {
+    if (k >= 0) {
+        return (k <= 22)? v*imp_pow10_f64[k] : v*pow(10, k);
+    }
+    return (k >= -22)? v/imp_pow10_f64[-k] : v*pow(10, k);
+}
+
+/* Precision for labels of ticks step apart on an axis showing values up to max_abs */
+TickFormat imp_tick_format(f64 step, f64 max_abs) {
+    TickFormat result = {0};
+    if (!(step > 0 && step < INFINITY)) {
+        return result;
+    }
+    s32 e = floor(log10(step) + 1e-9);
+    /* Steps like 0.25 need digits past their leading one */
+    for (s32 i = 0; i < 2; i++) {
+        f64 m = scale_pow10(step, -e);
+        if (fabs(m - round(m)) <= 1e-6*m) {
+            break;
+        }
+        e--;
+    }
+    s32 mag = (max_abs > 0 && max_abs < INFINITY)? floor(log10(max_abs)) : e;
+    result.step_exponent = e;
+    result.scientific = (e >= 6) || (mag < -4) || (mag - e > 15);
+    return result;
+}
+
+/* Writes n with decimals digits after the point and trailing zeros trimmed */
+static char *write_decimal(char *p, u64 n, s32 decimals) {
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *d = end;
+    while (n >= 100) {
+        d -= 2;
+        memcpy(d, imp_digit_pairs + 2*(n % 100), 2);
+        n /= 100;
+    }
+    if (n >= 10) {
+        d -= 2;
+        memcpy(d, imp_digit_pairs + 2*n, 2);
+    } else {
+        *--d = '0' + n;
+    }
+    while (end - d <= decimals) {
+        *--d = '0';
+    }
+    while (decimals > 0 && end[-1] == '0') {
+        end--;
+        decimals--;
+    }
+    s32 whole = end - d - decimals;
+    memcpy(p, d, whole);
+    p += whole;
+    if (decimals > 0) {
+        *p++ = '.';
+        memcpy(p, d + whole, decimals);
+        p += decimals;
+    }
+    return p;
+}
+
+/* Label for tick value v, written to the frame's char buffer like strf */
+str imp_tick_label(Context *imp, f64 v, TickFormat format) {
+    char buf[48];
+    char *p = buf;
+    f64 a = fabs(v);
+    s32 decimals = MIN(MAX(-format.step_exponent, 0), 17);
+    b32 scientific = format.scientific || scale_pow10(a, decimals) >= 1e18;
+    s32 exponent = 0;
+    u64 n;
+    if (scientific && a < INFINITY) {
+        /* NOTE(lcf): round to the step first, noise near 0 would get an exponent of its own */
+        a = scale_pow10(round(scale_pow10(a, -format.step_exponent)), format.step_exponent);
+    }
+    if (!(a < INFINITY)) {
+        memcpy(p, (a == a)? "inf" : "nan", 3);
+        p += 3;
+        n = 0;
+        scientific = 0;
+    } else if (scientific && a > 0) {
+        exponent = floor(log10(a));
+        decimals = MIN(MAX(exponent - format.step_exponent, 0), 15);
+        n = llround(scale_pow10(a, decimals - exponent));
+        if (n >= imp_pow10_f64[decimals + 1]) {
+            n /= 10;
+            exponent++;
+        }
+    } else {
+        n = llround(scale_pow10(a, decimals));
+    }
+    /* NOTE(lcf): no "-0" for values that round to zero */
+    if (v < 0 && n != 0) {
+        *p++ = '-';
+    }
+    if (a < INFINITY) {
+        p = write_decimal(p, n, decimals);
+    }
+    if (scientific && n != 0) {
+        *p++ = 'e';
+        if (exponent < 0) {
+            *p++ = '-';
+        }
+        p = write_decimal(p, abs(exponent), 0);
+    }
+
+    str result = {0};
+    s32 len = p - buf;
+    if (imp->char_pos + len + 1 <= IMP_CHAR_BUFFER_SIZE) {
+        result.str = imp->char_buffer + imp->char_pos;
+        result.len = len;
+        memcpy(result.str, buf, len);
+        result.str[len] = '\0';
+        imp->char_pos += len + 1;
+    }
+    return result;
+}
+
 #define HEXCOLOR(hex) {                         \
         .a = (hex >> (0x0 * 0x8)) & 0xFF,       \
             .b = (hex >> (0x1 * 0x8)) & 0xFF,   \
@@ -423,207 +835,1265 @@ Vec2 view_to_screen_raw(Rect view, Rect screen, Vec2 p) {
 Vec2 view_to_screen(Plot *plot, Vec2 p) {
     return view_to_screen_raw(plot->view, plot->screen, p);
 }
+/* Same mapping as view_to_screen_raw as a column major matrix, so backends can keep series
+   in view space on the gpu and only update this on pan/zoom. */
+HMM_Mat4 view_to_screen_matrix(Rect view, Rect screen) {
+    HMM_Mat4 m = HMM_M4D(1);
+    m.Elements[0][0] = screen.w/view.w;
+    m.Elements[1][1] = -screen.h/view.h;
+    m.Elements[3][0] = screen.x - view.x*screen.w/view.w;
+    m.Elements[3][1] = screen.y + screen.h + view.y*screen.h/view.h;
+    return m;
+}
+
 Vec2 screen_to_view(Plot *plot, Vec2 p) {
     return view_to_screen_raw(plot->screen, plot->view, p);
 }
 
-/* TODO move to command buffer read by backend */
 void draw_rect(Context *imp, Rect r, imp_Color c) {
-    RectCommand cmd = {
-        .base.type = IMP_COMMAND_RECT,
-        .base.color = c,
-        .screen = r
-    };
-    push_command(imp, (Command){.rect = cmd});
+    /* Grow the previous command into a rect list if it was the same color */
+    if (imp->prev_command >= 0) {
+        Command *prev = (Command *)(imp->command_buffer + imp->prev_command);
+        if (prev->base.color.raw == c.raw && prev->base.size + sizeof(Rect) <= 0xFFFF) {
+            if (prev->type == IMP_COMMAND_RECT) {
+                Rect first = prev->rect.screen;
+                imp->command_pos = imp->prev_command;
+                Command *cmd = push_command(imp, IMP_COMMAND_RECT_LIST, sizeof(RectListCommand) + 2*sizeof(Rect));
+                cmd->base.color = c;
+                cmd->rect_list.count = 2;
+                cmd->rect_list.rects[0] = first;
+                cmd->rect_list.rects[1] = r;
+                return;
+            }
+            if (prev->type == IMP_COMMAND_RECT_LIST) {
+                ASSERT(imp->command_pos + sizeof(Rect) <= IMP_COMMAND_BUFFER_SIZE);
+                prev->rect_list.rects[prev->rect_list.count++] = r;
+                prev->base.size += sizeof(Rect);
+                imp->command_pos += sizeof(Rect);
+                return;
+            }
+        }
+    }
+
+    Command *cmd = push_command(imp, IMP_COMMAND_RECT, sizeof(RectCommand));
+    cmd->base.color = c;
+    cmd->rect.screen = r;
+}
+
+void draw_grid(Context *imp, Vec2 origin, f32 step, f32 length, s32 count, s32 orientation, imp_Color c) {
+    if (count <= 0) {
+        return;
+    }
+    Command *cmd = push_command(imp, IMP_COMMAND_GRID, sizeof(GridCommand));
+    cmd->base.color = c;
+    cmd->grid.origin = origin;
+    cmd->grid.step = step;
+    cmd->grid.length = length;
+    cmd->grid.count = count;
+    cmd->grid.orientation = orientation;
 }
 
-void draw_grid_line(Context *imp, Vec2 start, Vec2 end, imp_Color c) {
-    draw_rect(imp, (Rect){ .x = start.x, .y = end.y, .w = MAX(1,end.x-start.x), .h=MAX(1,start.y-end.y)}, c);
+/* Screen rect of the i'th line of a grid command, for backends that expand grids into rects */
+Rect grid_line_rect(GridCommand *grid, s32 i) {
+    if (grid->orientation == IMP_GRID_VERTICAL) {
+        return (Rect){ .x = grid->origin.x + i*grid->step, .y = grid->origin.y, .w = 1, .h = grid->length };
+    } else {
+        return (Rect){ .x = grid->origin.x, .y = grid->origin.y + i*grid->step, .w = grid->length, .h = 1 };
+    }
 }
 
 void draw_text(Context *imp, Vec2 pos, str text, f32 w, imp_Color c) {
     if (!w) {
         w = imp->text_width_fun(imp->text_width_data, text.str, text.len);
     }
-    TextCommand cmd = {
-        .base.type = IMP_COMMAND_TEXT,
-        .base.color = c,
-        .screen = {.x = pos.x, .y = pos.y, .w = w, .h = imp->text_height},
-        .text = text
-    };
-    push_command(imp, (Command){.text=cmd});
+    Command *cmd = push_command(imp, IMP_COMMAND_TEXT, sizeof(TextCommand));
+    cmd->base.color = c;
+    cmd->text.screen = (Rect){.x = pos.x, .y = pos.y, .w = w, .h = imp->text_height};
+    cmd->text.text = text;
 }
 
 void draw_data(Context *imp, Plot *plot, Data data) {
+    /* NOTE(lcf): backends only know f32, pass imp_shown_data */
+    ASSERT(data.data_size != 8);
     if (~data.flags & IMP_DATA_CUSTOM_VIEW) {
         data.view = plot->view;
     }
-    
-    DataCommand cmd = {
-        .base.type = IMP_COMMAND_DATA,
-        .screen = plot->screen,
-        .data = data
-    };
-    push_command(imp, (Command){.data = cmd});
+
+    Command *cmd = push_command(imp, IMP_COMMAND_DATA, sizeof(DataCommand));
+    cmd->base.color = data.color;
+    cmd->data.screen = plot->screen;
+    cmd->data.data = data;
 }
 
-enum {
-    TEXT_LEFT = 0,
-    TEXT_CENTERED,
-    TEXT_RIGHT
-};
-Vec2 position_text(Context *imp, Vec2 pos, str text, s32 align, f32 *out_w) {
-    s32 w = imp->text_width_fun(imp->text_width_data, text.str, text.len);
-    switch (align) {
-    case TEXT_LEFT: { pos.x = pos.x; pos.y = pos.y; } break;
-    case TEXT_CENTERED: { pos.x = pos.x - w/2; pos.y = pos.y; } break;
-    case TEXT_RIGHT: { pos.x = pos.x - w; pos.y = pos.y; } break;
+f64 scale_value(s32 scale, f64 linear, f64 v) {
+    switch (scale) {
+    case IMP_SCALE_LOG10: return (v > 0 && v < INFINITY)? log10(v) : NAN;
+    case IMP_SCALE_SYMLOG: return (v < 0)? -log10(1 - v/linear) : log10(1 + v/linear);
     }
-
-    if (out_w) *out_w = w;
-    
-    return pos;
+    return v;
 }
-/* */
 
-void imp_init(Context *imp, s32 (*text_width_fun)(const void*, const char*, s32), void* text_width_data,  s32 text_height) {
-    *imp = (Context){0};
-    imp->text_width_fun = text_width_fun;
-    imp->text_width_data = text_width_data;
-    imp->text_height = text_height;
-    imp->next_id  = HASH_INITIAL;
+f64 unscale_value(s32 scale, f64 linear, f64 v) {
+    switch (scale) {
+    case IMP_SCALE_LOG10: return pow(10, v);
+    case IMP_SCALE_SYMLOG: return (v < 0)? -linear*(pow(10, -v) - 1) : linear*(pow(10, v) - 1);
+    }
+    return v;
 }
 
-void imp_begin(Context *imp, Inputs frame_input) {
-    imp->input.last_mouse = (frame_input.last_mouse.x && frame_input.last_mouse.y)?
-        frame_input.last_mouse : imp->input.mouse;
-    imp->input.mouse_pressed = frame_input.mouse_down && !imp->input.mouse_down;
-    imp->input.mouse = frame_input.mouse;
-    imp->input.mouse_scroll = frame_input.mouse_scroll;
-    imp->input.mouse_down = frame_input.mouse_down;
-
-    imp->char_pos = 0;
-    imp->command_pos = 1;
+#ifdef IMP_USE_SSE2
+/* log10 of 4 floats, within about 1 ulp of log10f for normal x. x = m*2^e with m in
+   [sqrt(1/2), sqrt(2)), and ln(m) = 2*atanh(s) for s = (m-1)/(m+1) is an odd series in
+   |s| < 0.172 that is done after the s^9 term. x <= 0, inf and NaN give NaN. */
+static __m128 log10_ps(__m128 x) {
+    __m128i bits = _mm_castps_si128(x);
+    __m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+    __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(1.41421356f));
+    m = _mm_sub_ps(m, _mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f))));
+    __m128 ef = _mm_add_ps(_mm_cvtepi32_ps(e), _mm_and_ps(big, _mm_set1_ps(1.0f)));
+
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 s = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+    __m128 s2 = _mm_mul_ps(s, s);
+    __m128 p = _mm_add_ps(_mm_set1_ps(1.0f/7), _mm_mul_ps(s2, _mm_set1_ps(1.0f/9)));
+    p = _mm_add_ps(_mm_set1_ps(1.0f/5), _mm_mul_ps(s2, p));
+    p = _mm_add_ps(_mm_set1_ps(1.0f/3), _mm_mul_ps(s2, p));
+    p = _mm_add_ps(one, _mm_mul_ps(s2, p));
+    __m128 lnm = _mm_mul_ps(_mm_add_ps(s, s), p);
+
+    __m128 r = _mm_add_ps(_mm_mul_ps(ef, _mm_set1_ps(0.30102999566f)), _mm_mul_ps(lnm, _mm_set1_ps(0.43429448190f)));
+    __m128 invalid = _mm_or_ps(_mm_cmpngt_ps(x, _mm_setzero_ps()), _mm_cmpnlt_ps(x, _mm_set1_ps(INFINITY)));
+    return _mm_or_ps(r, invalid);
+}
+#endif
 
-    imp->current_plot = -1;
+/* Writes in[0, n) through scale to out. in is f32, or f64 if data_size is 8, and may be out.
+   On linear axes origin is taken off in f64 before rounding to f32, so values near it keep
+   their precision however large they are. Log axes are never rebased and ignore it. */
+void imp_scale_values(s32 scale, f32 linear, f64 origin, const void *in, s32 data_size, f32 *out, s32 n) {
+    s32 i = 0;
+    if (scale == IMP_SCALE_LINEAR && (data_size == 8 || origin != 0)) {
+#ifdef IMP_USE_SSE2
+        __m128d o = _mm_set1_pd(origin);
+        if (data_size == 8) {
+            const f64 *v = in;
+            for (; i + 4 <= n; i += 4) {
+                __m128 lo = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(v + i), o));
+                __m128 hi = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(v + i + 2), o));
+                _mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+            }
+        } else {
+            const f32 *v = in;
+            for (; i + 4 <= n; i += 4) {
+                __m128 x = _mm_loadu_ps(v + i);
+                __m128 lo = _mm_cvtpd_ps(_mm_sub_pd(_mm_cvtps_pd(x), o));
+                __m128 hi = _mm_cvtpd_ps(_mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(x, x)), o));
+                _mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+            }
+        }
+#endif
+        for (; i < n; i++) {
+            out[i] = ((data_size == 8)? ((const f64 *)in)[i] : ((const f32 *)in)[i]) - origin;
+        }
+        return;
+    }
+    if (data_size == 8) {
+        const f64 *v = in;
+#ifdef IMP_USE_SSE2
+        for (; i + 4 <= n; i += 4) {
+            __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(v + i));
+            __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(v + i + 2));
+            _mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+        }
+#endif
+        for (; i < n; i++) {
+            out[i] = v[i];
+        }
+        in = out;
+    }
+    if (scale == IMP_SCALE_LINEAR) {
+        if (in != out) {
+            memmove(out, in, n*sizeof(f32));
+        }
+        return;
+    }
 
-    imp->first_plot = 0;
-    imp->prev_plot = 0;
+    const f32 *v = in;
+    i = 0;
+#ifdef IMP_USE_SSE2
+    if (scale == IMP_SCALE_LOG10) {
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_ps(out + i, log10_ps(_mm_loadu_ps(v + i)));
+        }
+    } else {
+        __m128 sign = _mm_set1_ps(-0.0f);
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 inv = _mm_set1_ps(1.0f/linear);
+        for (; i + 4 <= n; i += 4) {
+            __m128 x = _mm_loadu_ps(v + i);
+            __m128 r = log10_ps(_mm_add_ps(one, _mm_mul_ps(_mm_andnot_ps(sign, x), inv)));
+            _mm_storeu_ps(out + i, _mm_or_ps(r, _mm_and_ps(sign, x)));
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = scale_value(scale, linear, v[i]);
+    }
+}
 
-    imp->counter++;
+static f32 plot_symlog_linear(Plot *plot) {
+    return (plot->symlog_linear > 0)? plot->symlog_linear : 1;
 }
 
-Plot * begin_plot(Context *imp, Rect r, str title) {
-    ASSERT(imp->current_plot == -1);
+/* NOTE(lcf): decades and data units have nothing to do with each other, so a log or symlog
+   axis never ties the view to the screen's aspect */
+static b32 plot_free_aspect(Plot *plot) {
+    return (plot->flags & IMP_PLOT_FREE_ASPECT) || plot->scale_x != IMP_SCALE_LINEAR || plot->scale_y != IMP_SCALE_LINEAR;
+}
 
-    /* User can override next_id to give their plot whatever id they want */
-    if (imp->next_id == HASH_INITIAL) {
-        hash(&imp->next_id, title.str, title.len);
+/* Everything cached from the shown series is in scaled units, drop it when the scales change */
+static void plot_check_scale(Plot *plot) {
+    u32 key = HASH_INITIAL;
+    f32 linear = plot_symlog_linear(plot);
+    hash(&key, &plot->scale_x, sizeof(s32));
+    hash(&key, &plot->scale_y, sizeof(s32));
+    hash(&key, &linear, sizeof(f32));
+    if (key == plot->scale_key) {
+        return;
+    }
+    plot->scale_key = key;
+    for (s32 i = 0; i < IMP_MAX_DATA; i++) {
+        plot->data_index[i].built = 0;
+        plot->data_bounds[i].built = 0;
+        plot->scaled[i].built = 0;
     }
+    plot->ticks[0].built = 0;
+    plot->ticks[1].built = 0;
+}
 
-    Plot *plot = alloc_plot(imp);
+/* The series as it is drawn: f32, in the scaled units of each axis. Series that are already
+   f32 on linear axes are returned as is, anything else is converted into plot->scaled and only
+   the new tail is converted when n grows. */
+Data imp_shown_data(Plot *plot, s32 series) {
+    plot_check_scale(plot);
+    Data *data = plot->data + series;
+    Data shown = *data;
+    b32 custom = (data->flags & IMP_DATA_CUSTOM_VIEW) != 0;
+    f64 origin_x = custom? 0 : plot->origin_x;
+    f64 origin_y = custom? 0 : plot->origin_y;
+    b32 scale_x = plot->scale_x != IMP_SCALE_LINEAR || data->data_size == 8 || origin_x != 0;
+    b32 scale_y = plot->scale_y != IMP_SCALE_LINEAR || data->data_size == 8 || origin_y != 0;
+    if (!(scale_x || scale_y) || data->n <= 0) {
+        return shown;
+    }
 
-    if (imp->first_plot == 0) {
-        imp->first_plot = plot;
+    ScaledData *scaled = plot->scaled + series;
+    s32 first = scaled->n;
+    if (!scaled->built || scaled->version != data->version || data->n < scaled->n ||
+        scaled->origin_x != origin_x || scaled->origin_y != origin_y) {
+        first = 0;
+        scaled->generation++;
+    }
+    if (data->n > scaled->capacity) {
+        scaled->capacity = MAX(data->n, 2*scaled->capacity);
+        scaled->x = realloc(scaled->x, scaled->capacity*sizeof(f32));
+        scaled->y = realloc(scaled->y, scaled->capacity*sizeof(f32));
     }
 
-    plot->screen = r;
-    plot->last_mouse = plot->mouse;
-    plot->mouse = screen_to_view(plot, imp->input.mouse);
+    s32 size = (data->data_size == 8)? 8 : 4;
+    f32 linear = plot_symlog_linear(plot);
+    if (scale_x) {
+        imp_scale_values(plot->scale_x, linear, origin_x, (u8 *)data->x + first*size, size, scaled->x + first, data->n - first);
+    }
+    if (scale_y) {
+        imp_scale_values(plot->scale_y, linear, origin_y, (u8 *)data->y + first*size, size, scaled->y + first, data->n - first);
+    }
+    scaled->built = 1;
+    scaled->version = data->version;
+    scaled->n = data->n;
+    scaled->origin_x = origin_x;
+    scaled->origin_y = origin_y;
+
+    shown.x = scale_x? scaled->x : data->x;
+    shown.y = scale_y? scaled->y : data->y;
+    shown.z = 0;
+    shown.data_size = sizeof(f32);
+    shown.version = scaled->generation;
+    return shown;
+}
 
-    if (plot->view.w == 0) {
-        plot->view = (Rect){ .x = -10, .y = -10, .w = 20};
-        plot->target_view = plot->view;
+/* NOTE(lcf): a linear axis is rebased once its target view's center is more than this many
+   view widths from the origin. f32 then still resolves about 1/4000 of the view. */
+#define IMP_REBASE_LIMIT 1024
 
-        /* TODO(lcf): remove, just using to test pushing some data */
-        s32 n = 0x2000;
-        plot->data[0].n = n;
-        plot->data[0].x = malloc(n*sizeof(f32));
-        plot->data[0].y = malloc(n*sizeof(f32));
-        plot->data[0].z = malloc(n*sizeof(f32));
+/* Moves the origin of axis 0 (x) or 1 (y) by shift, everything in view units stays put */
+static void plot_rebase(Plot *plot, s32 axis, f64 shift) {
+    f32 *values[] = {
+        &(&plot->view.x)[axis], &(&plot->target_view.x)[axis], &(&plot->drag.x)[axis],
+        &(&plot->mouse.x)[axis], &(&plot->last_mouse.x)[axis],
+    };
+    for (s32 i = 0; i < (s32)(sizeof(values)/sizeof(values[0])); i++) {
+        *values[i] = *values[i] - shift;
+    }
+    (&plot->origin_x)[axis] += shift;
+}
 
-        for (s32 i = 0; i < n; i++) {
-            plot->data[0].x[i] = (i-n/2)*0.1;
-            plot->data[0].y[i] = 5.0*sin(i);
-            plot->data[0].z[i] = 0;
+/* Keeps each linear axis' origin near where the view is headed, log axes stay at 0 */
+static void plot_check_origin(Plot *plot) {
+    for (s32 axis = 0; axis < 2; axis++) {
+        s32 scale = axis? plot->scale_y : plot->scale_x;
+        f64 origin = (&plot->origin_x)[axis];
+        f64 w = fabs((&plot->target_view.w)[axis]);
+        f64 center = (&plot->target_view.x)[axis] + 0.5*(&plot->target_view.w)[axis];
+        if (scale != IMP_SCALE_LINEAR) {
+            if (origin != 0) {
+                plot_rebase(plot, axis, -origin);
+            }
+        } else if (fabs(center) > IMP_REBASE_LIMIT*w) {
+            plot_rebase(plot, axis, center);
         }
-        
-        plot->data[0].color = (imp_Color)HEXCOLOR(0xff0059ff);
-        plot->flags = IMP_PLOT_DRAW_ALL_3D;
-
-        plot->camera_pos = HMM_V3(1, 1, 1);
-        plot->camera_target = HMM_V3(0, 0, 0);
-        plot->camera_up = HMM_V3(0, 1, 1);
-        plot->camera = HMM_LookAt_RH(plot->camera_pos, plot->camera_target, plot->camera_up);
-        plot->view_to_screen = HMM_Perspective_RH_NO(90, plot->screen.w/plot->screen.h, 0.0001, 1000);
-        plot->screen_to_view = HMM_InvPerspective_RH(plot->view_to_screen);
-        plot->view_to_screen = HMM_MulM4(plot->view_to_screen, plot->camera);
     }
+}
 
-    plot->camera = HMM_Rotate_RH(imp->counter*0.001, HMM_V3(0, 0, 1));
+/* The plot view in (scaled) data units */
+Rect64 imp_view64(Plot *plot) {
+    return (Rect64){
+        .x = plot->origin_x + plot->view.x,
+        .y = plot->origin_y + plot->view.y,
+        .w = plot->view.w,
+        .h = plot->view.h,
+    };
+}
 
-    plot->view.h = plot->view.w * (plot->screen.h / plot->screen.w);
-    plot->target_view.h = plot->target_view.w * (plot->screen.h / plot->screen.w);
+/* Sets target_view from a view in (scaled) data units. The origin moves first if the target is
+   too far from it for f32 to hold. */
+void imp_set_view64(Plot *plot, Rect64 target) {
+    for (s32 axis = 0; axis < 2; axis++) {
+        s32 scale = axis? plot->scale_y : plot->scale_x;
+        f64 center = (&target.x)[axis] + 0.5*(&target.w)[axis];
+        f64 origin = (&plot->origin_x)[axis];
+        if (scale == IMP_SCALE_LINEAR && fabs(center - origin) > IMP_REBASE_LIMIT*fabs((&target.w)[axis])) {
+            plot_rebase(plot, axis, center - origin);
+        }
+    }
+    plot->target_view = (Rect){
+        .x = target.x - plot->origin_x,
+        .y = target.y - plot->origin_y,
+        .w = target.w,
+        .h = target.h,
+    };
+}
 
-    plot->first_command = imp->command_pos;
-    
-    return plot;
+/* Raw value i of an axis of data, for labels */
+static f64 data_value(Data *data, f32 *axis, s32 i) {
+    return (data->data_size == 8)? ((f64 *)axis)[i] : axis[i];
 }
 
-b32 point_in_rect(Rect r, Vec2 p) {
-    return !(
-        (p.x < r.x) ||
-        (p.y < r.y) ||
-        (p.x > r.x+r.w) ||
-        (p.y > r.y+r.h)
-        );
+/* NOTE(lcf): pixels from the mouse a point can be and still get highlighted */
+#define IMP_HOVER_RADIUS 12
+/* NOTE(lcf): sorted x series scan at most this many points around the mouse before
+   falling back to the grid */
+#define IMP_INDEX_SCAN_LIMIT 4096
+
+static void data_index_update(DataIndex *index, Data *data) {
+    if (index->built && index->version == data->version && index->n == data->n) {
+        return;
+    }
+    index->built = 1;
+    index->version = data->version;
+    index->n = data->n;
+    index->has_grid = 0;
+
+    /* NOTE(lcf): NaN counts as unsorted, binary searches can't step over it */
+    index->sorted_x = data->x[0] == data->x[0];
+    for (s32 i = 1; i < data->n; i++) {
+        if (!(data->x[i] >= data->x[i-1])) {
+            index->sorted_x = 0;
+            break;
+        }
+    }
 }
 
-Vec2 clamp_to_rect(Rect r, Vec2 p) {
-    p.x = (p.x < r.x)? r.x : ((p.x > r.x + r.w)? r.x + r.w : p.x);
-    p.y = (p.y < r.y)? r.y : ((p.y > r.y + r.h)? r.y + r.h : p.y);
-    return p;
+static void data_index_cell(DataIndex *index, f32 x, f32 y, s32 *cx, s32 *cy) {
+    f32 fx = (x - index->bounds.x)/index->bounds.w*index->grid_w;
+    f32 fy = (y - index->bounds.y)/index->bounds.h*index->grid_h;
+    s32 i = (fx == fx)? MAX(MIN(fx, index->grid_w), -1) : 0;
+    s32 j = (fy == fy)? MAX(MIN(fy, index->grid_h), -1) : 0;
+    *cx = (i < 0)? 0 : (i >= index->grid_w)? index->grid_w - 1 : i;
+    *cy = (j < 0)? 0 : (j >= index->grid_h)? index->grid_h - 1 : j;
 }
 
-Vec2 fvec2(f32 x, f32 y) { return (Vec2) {.x = x, .y = y};};
-Vec2 vec2_lerp(Vec2 a, Vec2 b, f32 m) { return (Vec2){ m*a.x + (1-m)*b.x, m*a.y + (1-m)*b.y }; }
+/* Counting sort of point indices into cells, about 4 points a cell */
+static void data_index_build_grid(DataIndex *index, Data *data) {
+    s32 n = data->n;
+    /* NaN fails every compare, so it's left out of the bounds and clamped into a corner cell */
+    f32 x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+    for (s32 i = 0; i < n; i++) {
+        if (data->x[i] < x0) x0 = data->x[i];
+        if (data->x[i] > x1) x1 = data->x[i];
+        if (data->y[i] < y0) y0 = data->y[i];
+        if (data->y[i] > y1) y1 = data->y[i];
+    }
+    if (x0 > x1) x0 = x1 = 0;
+    if (y0 > y1) y0 = y1 = 0;
+    Rect b = {.x = x0, .y = y0, .w = MAX(x1 - x0, 1e-30), .h = MAX(y1 - y0, 1e-30)};
+    index->bounds = b;
+
+    s32 side = sqrt(n/4.0) + 1;
+    index->grid_w = index->grid_h = MIN(side, 4096);
+    s32 cells = index->grid_w*index->grid_h;
+    if (cells + 1 > index->cell_capacity) {
+        index->cell_capacity = cells + 1;
+        index->cell_start = realloc(index->cell_start, index->cell_capacity*sizeof(s32));
+    }
+    if (n > index->point_capacity) {
+        index->point_capacity = n;
+        index->cell_points = realloc(index->cell_points, index->point_capacity*sizeof(s32));
+    }
 
-void end_plot(Context *imp) {
-    Plot *plot = current_plot(imp);
-    draw_rect(imp, plot->screen, color(PLOTBG));
+    s32 *start = index->cell_start;
+    memset(start, 0, (cells + 1)*sizeof(s32));
+    for (s32 i = 0; i < n; i++) {
+        s32 cx, cy;
+        data_index_cell(index, data->x[i], data->y[i], &cx, &cy);
+        start[cy*index->grid_w + cx + 1]++;
+    }
+    for (s32 c = 0; c < cells; c++) {
+        start[c + 1] += start[c];
+    }
+    for (s32 i = 0; i < n; i++) {
+        s32 cx, cy;
+        data_index_cell(index, data->x[i], data->y[i], &cx, &cy);
+        index->cell_points[start[cy*index->grid_w + cx]++] = i;
+    }
+    /* Filling moved every start up by one cell, shift back */
+    for (s32 c = cells; c > 0; c--) {
+        start[c] = start[c - 1];
+    }
+    start[0] = 0;
+    index->has_grid = 1;
+}
 
-    if (point_in_rect(plot->view, plot->mouse)) {
-        /* Drag */
-        Vec2 mouse_delta = {plot->mouse.x - plot->target_view.x, plot->mouse.y - plot->target_view.y};
-        if (imp->input.mouse_pressed) {
-            plot->drag.x = plot->target_view.x + mouse_delta.x;
-            plot->drag.y = plot->target_view.y + mouse_delta.y;
+/* Returns the point of series nearest to p (in view coordinates) measured in screen pixels,
+   or -1 if none is within max_px */
+s32 imp_nearest_point(Plot *plot, s32 series, Vec2 p, f32 max_px) {
+    Data shown = imp_shown_data(plot, series);
+    Data *data = &shown;
+    DataIndex *index = plot->data_index + series;
+    if (data->n <= 0) {
+        return -1;
+    }
+    data_index_update(index, data);
+
+    Rect view = (data->flags & IMP_DATA_CUSTOM_VIEW)? data->view : plot->view;
+    f32 sx = plot->screen.w/view.w;
+    f32 sy = plot->screen.h/view.h;
+    f32 best = max_px*max_px;
+    s32 nearest = -1;
+
+#define TRY_POINT(i) do { \
+        f32 dx = (data->x[i] - p.x)*sx, dy = (data->y[i] - p.y)*sy; \
+        f32 d = dx*dx + dy*dy; \
+        if (d < best) { best = d; nearest = (i); } \
+    } while (0)
+
+    if (index->sorted_x) {
+        /* Only points within max_px in x can win */
+        f32 lo_x = p.x - max_px/sx, hi_x = p.x + max_px/sx;
+        s32 lo = 0, hi = data->n;
+        while (lo < hi) {
+            s32 mid = lo + (hi - lo)/2;
+            if (data->x[mid] < lo_x) lo = mid + 1; else hi = mid;
         }
-        if (imp->input.mouse_down) {
-            plot->target_view.x = plot->drag.x - mouse_delta.x;
-            plot->target_view.y = plot->drag.y - mouse_delta.y;
+        s32 first = lo;
+        hi = data->n;
+        while (lo < hi) {
+            s32 mid = lo + (hi - lo)/2;
+            if (data->x[mid] <= hi_x) lo = mid + 1; else hi = mid;
+        }
+        if (lo - first <= IMP_INDEX_SCAN_LIMIT) {
+            for (s32 i = first; i < lo; i++) {
+                TRY_POINT(i);
+            }
+            return nearest;
         }
+    }
 
-        /* Zoom */
-        if (abs(imp->input.mouse_scroll) > 0.01) {
-            Vec2 center = {plot->target_view.x + plot->target_view.w/2, plot->target_view.y + plot->target_view.h/2};
-            if (imp->input.mouse_scroll > 0) {
-                plot->target_view.w = plot->target_view.w*1.05*imp->input.mouse_scroll;
-                plot->target_view.h = plot->target_view.h*1.05*imp->input.mouse_scroll;
+    if (!index->has_grid) {
+        data_index_build_grid(index, data);
+    }
+
+    /* Search rings of cells outward. Anything in ring r is at least r-1 cells away along
+       one axis, so stop once that can't beat the best so far. */
+    s32 cx, cy;
+    data_index_cell(index, p.x, p.y, &cx, &cy);
+    f32 cell_px = MIN(index->bounds.w/index->grid_w*fabs(sx), index->bounds.h/index->grid_h*fabs(sy));
+    s32 max_ring = MAX(index->grid_w, index->grid_h);
+    for (s32 r = 0; r <= max_ring; r++) {
+        f32 bound = (r - 1)*cell_px;
+        if (r > 1 && bound*bound >= best) {
+            break;
+        }
+        for (s32 j = cy - r; j <= cy + r; j++) {
+            if (j < 0 || j >= index->grid_h) continue;
+            /* Whole rows at the top and bottom of the ring, just the ends in between */
+            s32 step = (j == cy - r || j == cy + r)? 1 : MAX(2*r, 1);
+            for (s32 i = cx - r; i <= cx + r; i += step) {
+                if (i < 0 || i >= index->grid_w) continue;
+                s32 c = j*index->grid_w + i;
+                for (s32 k = index->cell_start[c]; k < index->cell_start[c + 1]; k++) {
+                    TRY_POINT(index->cell_points[k]);
+                }
+            }
+        }
+    }
+#undef TRY_POINT
+
+    return nearest;
+}
+
+void draw_highlight(Context *imp, Plot *plot, s32 series, s32 index) {
+    Data data = imp_shown_data(plot, series);
+    Rect view = (data.flags & IMP_DATA_CUSTOM_VIEW)? data.view : plot->view;
+    Command *cmd = push_command(imp, IMP_COMMAND_HIGHLIGHT, sizeof(HighlightCommand));
+    cmd->base.color = data.color;
+    cmd->highlight.screen = view_to_screen_raw(view, plot->screen, (Vec2){data.x[index], data.y[index]});
+    cmd->highlight.series = series;
+    cmd->highlight.index = index;
+}
+
+/* Folds the finite values of p[first, first + count) into min and max. NaN and inf are
+   skipped by turning them into NaN, which minps/maxps never return over the accumulator. */
+static void bounds_reduce(const void *p, s32 data_size, s32 first, s32 count, f64 *min, f64 *max) {
+    s32 i = 0;
+    f64 lo = *min, hi = *max;
+    if (data_size == 8) {
+        const f64 *v = (const f64 *)p + first;
+#ifdef IMP_USE_SSE2
+        __m128d sign = _mm_set1_pd(-0.0);
+        __m128d inf = _mm_set1_pd(INFINITY);
+        __m128d vlo0 = _mm_set1_pd(INFINITY), vlo1 = vlo0;
+        __m128d vhi0 = _mm_set1_pd(-INFINITY), vhi1 = vhi0;
+        for (; i + 4 <= count; i += 4) {
+            __m128d a = _mm_loadu_pd(v + i);
+            __m128d b = _mm_loadu_pd(v + i + 2);
+            a = _mm_or_pd(a, _mm_cmpnlt_pd(_mm_andnot_pd(sign, a), inf));
+            b = _mm_or_pd(b, _mm_cmpnlt_pd(_mm_andnot_pd(sign, b), inf));
+            vlo0 = _mm_min_pd(a, vlo0); vhi0 = _mm_max_pd(a, vhi0);
+            vlo1 = _mm_min_pd(b, vlo1); vhi1 = _mm_max_pd(b, vhi1);
+        }
+        f64 l[2], h[2];
+        _mm_storeu_pd(l, _mm_min_pd(vlo0, vlo1));
+        _mm_storeu_pd(h, _mm_max_pd(vhi0, vhi1));
+        lo = MIN(lo, MIN(l[0], l[1]));
+        hi = MAX(hi, MAX(h[0], h[1]));
+#endif
+        for (; i < count; i++) {
+            if (v[i] - v[i] == 0) {
+                lo = MIN(lo, v[i]);
+                hi = MAX(hi, v[i]);
+            }
+        }
+    } else {
+        const f32 *v = (const f32 *)p + first;
+#ifdef IMP_USE_SSE2
+        __m128 sign = _mm_set1_ps(-0.0f);
+        __m128 inf = _mm_set1_ps(INFINITY);
+        __m128 vlo0 = _mm_set1_ps(INFINITY), vlo1 = vlo0;
+        __m128 vhi0 = _mm_set1_ps(-INFINITY), vhi1 = vhi0;
+        for (; i + 8 <= count; i += 8) {
+            __m128 a = _mm_loadu_ps(v + i);
+            __m128 b = _mm_loadu_ps(v + i + 4);
+            a = _mm_or_ps(a, _mm_cmpnlt_ps(_mm_andnot_ps(sign, a), inf));
+            b = _mm_or_ps(b, _mm_cmpnlt_ps(_mm_andnot_ps(sign, b), inf));
+            vlo0 = _mm_min_ps(a, vlo0); vhi0 = _mm_max_ps(a, vhi0);
+            vlo1 = _mm_min_ps(b, vlo1); vhi1 = _mm_max_ps(b, vhi1);
+        }
+        f32 l[4], h[4];
+        _mm_storeu_ps(l, _mm_min_ps(vlo0, vlo1));
+        _mm_storeu_ps(h, _mm_max_ps(vhi0, vhi1));
+        for (s32 k = 0; k < 4; k++) {
+            lo = MIN(lo, l[k]);
+            hi = MAX(hi, h[k]);
+        }
+#endif
+        for (; i < count; i++) {
+            if (v[i] - v[i] == 0) {
+                lo = MIN(lo, v[i]);
+                hi = MAX(hi, v[i]);
+            }
+        }
+    }
+    *min = lo;
+    *max = hi;
+}
+
+/* axes are x, y, z of a series with version and n points, each f32 or f64 per sizes */
+static void data_bounds_update(DataBounds *bounds, u32 version, s32 n, void **axes, s32 *sizes) {
+    s32 first = bounds->n;
+    if (!bounds->built || bounds->version != version || n < bounds->n) {
+        first = 0;
+        for (s32 a = 0; a < 3; a++) {
+            bounds->min[a] = INFINITY;
+            bounds->max[a] = -INFINITY;
+        }
+    }
+
+    for (s32 a = 0; a < 3; a++) {
+        if (axes[a] && n > first) {
+            bounds_reduce(axes[a], sizes[a], first, n - first, &bounds->min[a], &bounds->max[a]);
+        }
+    }
+    bounds->built = 1;
+    bounds->version = version;
+    bounds->n = n;
+}
+
+/* Bounds of a series' finite x and y in scaled data units, before the origin is taken off.
+   Linear axes are read from the series itself so f64 data keeps its precision, log axes from
+   the shown copy. */
+static b32 series_bounds64(Plot *plot, s32 series, Rect64 *out) {
+    Data *data = plot->data + series;
+    Data shown = imp_shown_data(plot, series);
+    b32 log_x = plot->scale_x != IMP_SCALE_LINEAR;
+    b32 log_y = plot->scale_y != IMP_SCALE_LINEAR;
+    void *axes[3] = { log_x? shown.x : data->x, log_y? shown.y : data->y, data->z };
+    s32 sizes[3] = { log_x? 4 : data->data_size, log_y? 4 : data->data_size, data->data_size };
+    DataBounds *bounds = plot->data_bounds + series;
+    data_bounds_update(bounds, data->version, data->n, axes, sizes);
+    if (bounds->min[0] > bounds->max[0] || bounds->min[1] > bounds->max[1]) {
+        return 0;
+    }
+    *out = (Rect64){
+        .x = bounds->min[0],
+        .y = bounds->min[1],
+        .w = bounds->max[0] - bounds->min[0],
+        .h = bounds->max[1] - bounds->min[1],
+    };
+    return 1;
+}
+
+/* Bounds of a series' finite x and y in view units, returns 0 if there aren't any */
+b32 imp_series_bounds(Plot *plot, s32 series, Rect *out) {
+    Rect64 b;
+    if (!series_bounds64(plot, series, &b)) {
+        return 0;
+    }
+    b32 custom = (plot->data[series].flags & IMP_DATA_CUSTOM_VIEW) != 0;
+    *out = (Rect){
+        .x = b.x - (custom? 0 : plot->origin_x),
+        .y = b.y - (custom? 0 : plot->origin_y),
+        .w = b.w,
+        .h = b.h,
+    };
+    return 1;
+}
+
+/* Sets target_view to fit every series drawn in the plot view, with margin as a fraction of the
+   range on each side. Only the first call after a series changes has to scan it. */
+b32 imp_plot_autofit(Plot *plot, f32 margin) {
+    f64 x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+    for (s32 i = 0; i < IMP_MAX_DATA; i++) {
+        Rect64 b;
+        if (plot->data[i].n <= 0 || (plot->data[i].flags & IMP_DATA_CUSTOM_VIEW) || !series_bounds64(plot, i, &b)) {
+            continue;
+        }
+        x0 = MIN(x0, b.x); x1 = MAX(x1, b.x + b.w);
+        y0 = MIN(y0, b.y); y1 = MAX(y1, b.y + b.h);
+    }
+    if (x0 > x1) {
+        return 0;
+    }
+
+    f64 w = (x1 > x0)? (x1 - x0)*(1 + 2*margin) : 1;
+    f64 h = (y1 > y0)? (y1 - y0)*(1 + 2*margin) : 1;
+    /* NOTE(lcf): the view keeps the screen's aspect, so the other axis gets the slack */
+    if (plot->screen.w > 0 && plot->screen.h > 0 && !plot_free_aspect(plot)) {
+        w = MAX(w, h*plot->screen.w/plot->screen.h);
+        h = w*plot->screen.h/plot->screen.w;
+    }
+    imp_set_view64(plot, (Rect64){ .x = 0.5*(x0 + x1) - 0.5*w, .y = 0.5*(y0 + y1) - 0.5*h, .w = w, .h = h });
+    return 1;
+}
+
+static DataStats stats_empty(void) {
+    return (DataStats){ .min = INFINITY, .max = -INFINITY };
+}
+
+static DataStats stats_merge(DataStats a, DataStats b) {
+    return (DataStats){
+        .count = a.count + b.count,
+        .sum = a.sum + b.sum,
+        .sum2 = a.sum2 + b.sum2,
+        .min = MIN(a.min, b.min),
+        .max = MAX(a.max, b.max),
+    };
+}
+
+static DataStats stats_scan(Data *data, s32 first, s32 end) {
+    DataStats r = stats_empty();
+    for (s32 i = first; i < end; i++) {
+        f64 v = (data->data_size == 8)? ((f64 *)data->y)[i] : data->y[i];
+        if (v - v == 0) {
+            r.count++;
+            r.sum += v;
+            r.sum2 += v*v;
+            r.min = MIN(r.min, v);
+            r.max = MAX(r.max, v);
+        }
+    }
+    return r;
+}
+
+static void data_tree_update(DataTree *tree, Data *data) {
+    s32 first_block = tree->n/IMP_STATS_BLOCK;
+    if (!tree->built || tree->version != data->version || data->n < tree->n) {
+        first_block = 0;
+    }
+    s32 old_blocks = tree->blocks;
+    s32 blocks = (data->n + IMP_STATS_BLOCK - 1)/IMP_STATS_BLOCK;
+    s32 refit_block = first_block;
+
+    if (blocks > tree->leaves) {
+        s32 leaves = MAX(tree->leaves, 1);
+        while (leaves < blocks) {
+            leaves *= 2;
+        }
+        tree->node = realloc(tree->node, 2*leaves*sizeof(DataStats));
+        /* Blocks that are still valid move down to the new leaf row, everything above is refit */
+        for (s32 b = first_block - 1; b >= 0; b--) {
+            tree->node[leaves + b] = tree->node[tree->leaves + b];
+        }
+        tree->leaves = leaves;
+        old_blocks = leaves;
+        refit_block = 0;
+    }
+
+    s32 end = MAX(blocks, old_blocks);
+    for (s32 b = first_block; b < end; b++) {
+        tree->node[tree->leaves + b] = (b < blocks)?
+            stats_scan(data, b*IMP_STATS_BLOCK, MIN((b + 1)*IMP_STATS_BLOCK, data->n)) : stats_empty();
+    }
+
+    s32 lo = (tree->leaves + refit_block)/2;
+    s32 hi = (tree->leaves + MAX(end, 1) - 1)/2;
+    for (; hi >= 1; lo /= 2, hi /= 2) {
+        for (s32 k = lo; k <= hi; k++) {
+            tree->node[k] = stats_merge(tree->node[2*k], tree->node[2*k + 1]);
+        }
+    }
+
+    tree->built = 1;
+    tree->version = data->version;
+    tree->n = data->n;
+    tree->blocks = blocks;
+}
+
+/* Stats of y over points [first, end) of a series in O(log n) */
+DataStats imp_data_stats(Plot *plot, s32 series, s32 first, s32 end) {
+    Data *data = plot->data + series;
+    DataTree *tree = plot->data_tree + series;
+    first = MAX(first, 0);
+    end = MIN(end, data->n);
+    if (first >= end) {
+        return stats_empty();
+    }
+    data_tree_update(tree, data);
+
+    s32 b0 = (first + IMP_STATS_BLOCK - 1)/IMP_STATS_BLOCK;
+    s32 b1 = end/IMP_STATS_BLOCK;
+    if (b0 >= b1) {
+        return stats_scan(data, first, end);
+    }
+    DataStats r = stats_merge(stats_scan(data, first, b0*IMP_STATS_BLOCK), stats_scan(data, b1*IMP_STATS_BLOCK, end));
+    for (s32 l = tree->leaves + b0, h = tree->leaves + b1; l < h; l /= 2, h /= 2) {
+        if (l & 1) {
+            r = stats_merge(r, tree->node[l++]);
+        }
+        if (h & 1) {
+            r = stats_merge(r, tree->node[--h]);
+        }
+    }
+    return r;
+}
+
+/* Index range of a series with sorted x that falls inside the plot view. Returns 0 and the
+   whole series if x isn't sorted. */
+b32 imp_visible_range(Plot *plot, s32 series, s32 *first, s32 *end) {
+    Data *data = plot->data + series;
+    Data shown = imp_shown_data(plot, series);
+    data_index_update(plot->data_index + series, &shown);
+    *first = 0;
+    *end = data->n;
+    if (!plot->data_index[series].sorted_x) {
+        return 0;
+    }
+
+    /* The scale is monotonic, so the raw x can be searched for the unscaled view */
+    b32 custom = (data->flags & IMP_DATA_CUSTOM_VIEW) != 0;
+    Rect view = custom? data->view : plot->view;
+    f64 origin = custom? 0 : plot->origin_x;
+    f64 x0 = unscale_value(plot->scale_x, plot_symlog_linear(plot), origin + view.x);
+    f64 x1 = unscale_value(plot->scale_x, plot_symlog_linear(plot), origin + view.x + view.w);
+    s32 lo = 0, hi = data->n;
+    while (lo < hi) {
+        s32 mid = (lo + hi)/2;
+        if (data_value(data, data->x, mid) < x0) lo = mid + 1; else hi = mid;
+    }
+    *first = lo;
+    hi = data->n;
+    while (lo < hi) {
+        s32 mid = (lo + hi)/2;
+        if (data_value(data, data->x, mid) <= x1) lo = mid + 1; else hi = mid;
+    }
+    *end = lo;
+    return 1;
+}
+
+void imp_stream_init(Stream *stream, s32 capacity, f64 window) {
+    *stream = (Stream){
+        .capacity = capacity,
+        .window = window,
+        .x = malloc(2*capacity*sizeof(f32)),
+        .y = malloc(2*capacity*sizeof(f32)),
+        .min_queue = malloc(capacity*sizeof(s64)),
+        .max_queue = malloc(capacity*sizeof(s64)),
+        .data_count = -1,
+    };
+}
+
+#define QUEUE(q, i) stream->q##_queue[(stream->q##_head + (i)) % stream->capacity]
+/* Adds sample k to the back of both deques, after dropping whatever it dominates */
+static void stream_queue_push(Stream *stream, s64 k) {
+    f32 y = stream->y[k % stream->capacity];
+    if (y - y != 0) {
+        return;
+    }
+    while (stream->min_len > 0 && stream->y[QUEUE(min, stream->min_len - 1) % stream->capacity] >= y) {
+        stream->min_len--;
+    }
+    QUEUE(min, stream->min_len++) = k;
+    while (stream->max_len > 0 && stream->y[QUEUE(max, stream->max_len - 1) % stream->capacity] <= y) {
+        stream->max_len--;
+    }
+    QUEUE(max, stream->max_len++) = k;
+}
+
+/* Drops samples from the front that left the buffer or fell out of the window */
+static void stream_queue_trim(Stream *stream) {
+    s64 oldest = stream->count - stream->n;
+    f64 left = stream->x[(stream->count - 1) % stream->capacity] - stream->window;
+    while (stream->min_len > 0 && (QUEUE(min, 0) < oldest || stream->x[QUEUE(min, 0) % stream->capacity] < left)) {
+        stream->min_head = (stream->min_head + 1) % stream->capacity;
+        stream->min_len--;
+    }
+    while (stream->max_len > 0 && (QUEUE(max, 0) < oldest || stream->x[QUEUE(max, 0) % stream->capacity] < left)) {
+        stream->max_head = (stream->max_head + 1) % stream->capacity;
+        stream->max_len--;
+    }
+}
+
+/* Appends a sample, x should not decrease. O(1) amortized. */
+void imp_stream_push(Stream *stream, f32 x, f32 y) {
+    s64 k = stream->count++;
+    s32 slot = k % stream->capacity;
+    stream->x[slot] = stream->x[slot + stream->capacity] = x;
+    stream->y[slot] = stream->y[slot + stream->capacity] = y;
+    stream->n = MIN(stream->n + 1, stream->capacity);
+
+    /* The sample just overwritten has to go before anything compares against its slot */
+    if (stream->min_len > 0 && QUEUE(min, 0) == k - stream->capacity) {
+        stream->min_head = (stream->min_head + 1) % stream->capacity;
+        stream->min_len--;
+    }
+    if (stream->max_len > 0 && QUEUE(max, 0) == k - stream->capacity) {
+        stream->max_head = (stream->max_head + 1) % stream->capacity;
+        stream->max_len--;
+    }
+    stream_queue_push(stream, k);
+    stream_queue_trim(stream);
+}
+
+/* Changing the window refills the deques from the buffered samples */
+void imp_stream_set_window(Stream *stream, f64 window) {
+    if (window == stream->window) {
+        return;
+    }
+    stream->window = window;
+    stream->min_head = stream->min_len = 0;
+    stream->max_head = stream->max_len = 0;
+    for (s64 k = stream->count - stream->n; k < stream->count; k++) {
+        stream_queue_push(stream, k);
+    }
+    if (stream->n > 0) {
+        stream_queue_trim(stream);
+    }
+}
+#undef QUEUE
+
+/* Finite y range over the last window x units */
+b32 imp_stream_range(Stream *stream, f32 *min, f32 *max) {
+    if (stream->min_len == 0) {
+        return 0;
+    }
+    *min = stream->y[stream->min_queue[stream->min_head] % stream->capacity];
+    *max = stream->y[stream->max_queue[stream->max_head] % stream->capacity];
+    return 1;
+}
+
+/* Points data at the buffered samples, oldest first */
+void imp_stream_data(Stream *stream, Data *data) {
+    s32 first = (stream->count - stream->n) % stream->capacity;
+    data->x = stream->x + first;
+    data->y = stream->y + first;
+    data->z = 0;
+    data->n = stream->n;
+    data->data_size = sizeof(f32);
+    /* Once the buffer is full every push moves its start, which changes the contents at every
+       index. Until then samples are only appended and caches can take just the new tail. */
+    if (stream->count > stream->capacity && stream->data_count != stream->count) {
+        stream->data_count = stream->count;
+        data->version++;
+    }
+}
+
+/* Scrolls target_view to the last window x units and fits y to their range */
+void imp_stream_autoscale(Plot *plot, Stream *stream, f32 margin) {
+    f32 min, max;
+    if (stream->n == 0 || !imp_stream_range(stream, &min, &max)) {
+        return;
+    }
+    plot->flags |= IMP_PLOT_FREE_ASPECT;
+    f32 linear = plot_symlog_linear(plot);
+    f64 x1 = stream->x[(stream->count - 1) % stream->capacity];
+    f64 x0 = scale_value(plot->scale_x, linear, x1 - stream->window);
+    x1 = scale_value(plot->scale_x, linear, x1);
+    f64 y0 = scale_value(plot->scale_y, linear, min);
+    f64 y1 = scale_value(plot->scale_y, linear, max);
+    if (!(x1 > x0) || !(y1 >= y0)) {
+        return;
+    }
+    f64 h = (y1 > y0)? (y1 - y0)*(1 + 2*margin) : 1;
+    imp_set_view64(plot, (Rect64){ .x = x0, .y = 0.5*(y0 + y1) - 0.5*h, .w = x1 - x0, .h = h });
+}
+
+enum {
+    TEXT_LEFT = 0,
+    TEXT_CENTERED,
+    TEXT_RIGHT
+};
+Vec2 position_text(Context *imp, Vec2 pos, str text, s32 align, f32 *out_w) {
+    s32 w = imp->text_width_fun(imp->text_width_data, text.str, text.len);
+    switch (align) {
+    case TEXT_LEFT: { pos.x = pos.x; pos.y = pos.y; } break;
+    case TEXT_CENTERED: { pos.x = pos.x - w/2; pos.y = pos.y; } break;
+    case TEXT_RIGHT: { pos.x = pos.x - w; pos.y = pos.y; } break;
+    }
+
+    if (out_w) *out_w = w;
+    
+    return pos;
+}
+/* */
+
+void imp_init(Context *imp, s32 (*text_width_fun)(const void*, const char*, s32), void* text_width_data,  s32 text_height) {
+    *imp = (Context){0};
+    imp->text_width_fun = text_width_fun;
+    imp->text_width_data = text_width_data;
+    imp->text_height = text_height;
+    imp->next_id  = HASH_INITIAL;
+}
+
+void imp_begin(Context *imp, Inputs frame_input) {
+    imp->input.last_mouse = (frame_input.last_mouse.x && frame_input.last_mouse.y)?
+        frame_input.last_mouse : imp->input.mouse;
+    imp->input.mouse_pressed = frame_input.mouse_down && !imp->input.mouse_down;
+    imp->input.mouse = frame_input.mouse;
+    imp->input.mouse_scroll = frame_input.mouse_scroll;
+    imp->input.mouse_down = frame_input.mouse_down;
+    /* NOTE(lcf): clamped so the first frame after idling doesn't skip the whole animation */
+    imp->input.dt = (frame_input.dt > 0)? MIN(frame_input.dt, 0.1) : 1.0/60.0;
+
+    imp->char_pos = 0;
+    imp->command_pos = 0;
+    imp->prev_command = -1;
+
+    imp->current_plot = -1;
+
+    imp->first_plot = 0;
+    imp->prev_plot = 0;
+    imp->changed = 0;
+    imp->animating = 0;
+
+    imp->counter++;
+}
+
+Plot * begin_plot(Context *imp, Rect r, str title) {
+    ASSERT(imp->current_plot == -1);
+
+    /* User can override next_id to give their plot whatever id they want */
+    if (imp->next_id == HASH_INITIAL) {
+        hash(&imp->next_id, title.str, title.len);
+    }
+
+    Plot *plot = alloc_plot(imp);
+
+    if (imp->first_plot == 0) {
+        imp->first_plot = plot;
+    }
+
+    plot->screen = r;
+    plot->last_mouse = plot->mouse;
+    plot->mouse = screen_to_view(plot, imp->input.mouse);
+
+    if (plot->view.w == 0) {
+        plot->view = (Rect){ .x = -10, .y = -10, .w = 20};
+        plot->target_view = plot->view;
+
+        /* TODO(lcf): remove, just using to test pushing some data */
+        s32 n = 0x2000;
+        plot->data[0].n = n;
+        plot->data[0].x = malloc(n*sizeof(f32));
+        plot->data[0].y = malloc(n*sizeof(f32));
+        plot->data[0].z = malloc(n*sizeof(f32));
+
+        for (s32 i = 0; i < n; i++) {
+            plot->data[0].x[i] = (i-n/2)*0.1;
+            plot->data[0].y[i] = 5.0*sin(i);
+            plot->data[0].z[i] = 0;
+        }
+        
+        plot->data[0].color = (imp_Color)HEXCOLOR(0xff0059ff);
+        plot->data[0].flags = IMP_DATA_MARKERS;
+        plot->flags = IMP_PLOT_DRAW_ALL_3D;
+
+        plot->camera_pos = HMM_V3(1, 1, 1);
+        plot->camera_target = HMM_V3(0, 0, 0);
+        plot->camera_up = HMM_V3(0, 1, 1);
+        plot->camera = HMM_LookAt_RH(plot->camera_pos, plot->camera_target, plot->camera_up);
+        plot->view_to_screen = HMM_Perspective_RH_NO(90, plot->screen.w/plot->screen.h, 0.0001, 1000);
+        plot->screen_to_view = HMM_InvPerspective_RH(plot->view_to_screen);
+        plot->view_to_screen = HMM_MulM4(plot->view_to_screen, plot->camera);
+    }
+
+    plot->camera = HMM_Rotate_RH(imp->counter*0.001, HMM_V3(0, 0, 1));
+
+    if (!plot_free_aspect(plot)) {
+        plot->view.h = plot->view.w * (plot->screen.h / plot->screen.w);
+        plot->target_view.h = plot->target_view.w * (plot->screen.h / plot->screen.w);
+    }
+    plot_check_origin(plot);
+
+    plot->first_command = imp->command_pos;
+    imp->prev_command = -1;
+    
+    return plot;
+}
+
+b32 point_in_rect(Rect r, Vec2 p) {
+    return !(
+        (p.x < r.x) ||
+        (p.y < r.y) ||
+        (p.x > r.x+r.w) ||
+        (p.y > r.y+r.h)
+        );
+}
+
+/* NOTE(lcf): joins sharper than this (miter length over half width) are beveled */
+#define IMP_MITER_LIMIT 4.0
+
+static HMM_Vec3 polyline_normal(HMM_Vec3 dir, HMM_Vec3 facing) {
+    HMM_Vec3 normal = HMM_Cross(dir, facing);
+    if (HMM_LenSqrV3(normal) < 1e-12) {
+        /* segment points along facing, any perpendicular will do */
+        normal = HMM_Cross(dir, (fabs(dir.X) < fabs(dir.Y))? HMM_V3(1, 0, 0) : HMM_V3(0, 1, 0));
+    }
+    return HMM_NormV3(normal);
+}
+
+/* Tessellates a polyline into one triangle strip with two vertices (left, right) per point.
+   Joins are mitered, or beveled with one extra pair past IMP_MITER_LIMIT. facing is the
+   normal of the plane lines are widened in: +z for 2d, toward the camera for billboards.
+   out needs room for 4*n vertices. Returns the number of vertices written. */
+s32 tessellate_polyline(const HMM_Vec3 *p, s32 n, HMM_Vec3 facing, f32 width, HMM_Vec3 *out) {
+    s32 count = 0;
+    f32 hw = width/2;
+    HMM_Vec3 prev_normal = {0};
+    b32 have_prev = 0;
+
+#define EMIT(c, off) (out[count++] = HMM_AddV3((c), (off)), out[count++] = HMM_SubV3((c), (off)))
+    s32 i = 0;
+    while (i < n) {
+        /* skip repeated points, they have no direction */
+        s32 j = i + 1;
+        while (j < n && HMM_LenSqrV3(HMM_SubV3(p[j], p[i])) < 1e-12) {
+            j++;
+        }
+
+        if (j == n) {
+            if (have_prev) {
+                EMIT(p[i], HMM_MulV3F(prev_normal, hw));
+            }
+            break;
+        }
+
+        HMM_Vec3 normal = polyline_normal(HMM_SubV3(p[j], p[i]), facing);
+        if (!have_prev) {
+            EMIT(p[i], HMM_MulV3F(normal, hw));
+        } else {
+            /* miter = m*hw/cos(half angle), with cos(half angle) = |m|/2 for m = n0 + n1 */
+            HMM_Vec3 m = HMM_AddV3(prev_normal, normal);
+            f32 mm = HMM_DotV3(m, m);
+            if (mm > 4.0/(IMP_MITER_LIMIT*IMP_MITER_LIMIT)) {
+                EMIT(p[i], HMM_MulV3F(m, 2*hw/mm));
             } else {
-                plot->target_view.w = plot->target_view.w/(1.05*-imp->input.mouse_scroll);
-                plot->target_view.h = plot->target_view.h/(1.05*-imp->input.mouse_scroll);
+                EMIT(p[i], HMM_MulV3F(prev_normal, hw));
+                EMIT(p[i], HMM_MulV3F(normal, hw));
             }
-            plot->target_view.x = center.x - plot->target_view.w/2;
-            plot->target_view.y = center.y - plot->target_view.h/2;
         }
+
+        prev_normal = normal;
+        have_prev = 1;
+        i = j;
     }
+#undef EMIT
 
-    plot->view.pos = vec2_lerp(plot->view.pos, plot->target_view.pos, 0.1);
-    plot->view.size = vec2_lerp(plot->view.size, plot->target_view.size, 0.1);
+    return count;
+}
 
-    f64 maxdim = MAX(plot->view.w,plot->view.h);
-    f64 logscale = log(maxdim)/log(10);
+/* Liang-Barsky step for one box edge, narrows [t0, t1] or returns 0 if the segment misses */
+static b32 clip_edge(f32 p, f32 q, f32 *t0, f32 *t1) {
+    if (p == 0) {
+        return q >= 0;
+    }
+    f32 r = q/p;
+    if (p < 0) {
+        if (r > *t1) return 0;
+        if (r > *t0) *t0 = r;
+    } else {
+        if (r < *t0) return 0;
+        if (r < *t1) *t1 = r;
+    }
+    return 1;
+}
+
+#define IMP_CLIP_BLOCK 256
+
+/* Clips the polyline through (x[i*stride], y[i*stride], z[i*stride]) against the box min..max
+   and writes the visible pieces to out as separate polylines, piece r ending at run_ends[r].
+   Pass z = 0 for 2d, points are then at z = 0. Separate x, y, z arrays use stride 1, an array
+   of HMM_Vec3 can be passed as &p->X, &p->Y, &p->Z with stride 3.
+   out needs room for 2*n points and run_ends for n. Returns the number of points written. */
+s32 clip_polyline(const f32 *x, const f32 *y, const f32 *z, s32 stride, s32 n,
+                  HMM_Vec3 min, HMM_Vec3 max, HMM_Vec3 *out, s32 *run_ends, s32 *run_count) {
+    s32 count = 0;
+    s32 runs = 0;
+    b32 open = 0;
+    u8 codes[IMP_CLIP_BLOCK + 1];
+
+#define POINT(i) HMM_V3(x[(i)*stride], y[(i)*stride], z? z[(i)*stride] : 0)
+#define CLOSE_RUN() do { if (open) { run_ends[runs++] = count; open = 0; } } while (0)
+    for (s32 base = 0; base < n - 1; base += IMP_CLIP_BLOCK) {
+        s32 m = MIN(IMP_CLIP_BLOCK, n - 1 - base);
+
+        /* Outcodes for the whole block first, a branch free loop the compiler can vectorize */
+        for (s32 i = 0; i <= m; i++) {
+            s32 k = (base + i)*stride;
+            f32 px = x[k], py = y[k], pz = z? z[k] : 0;
+            codes[i] = (px < min.X) | (px > max.X) << 1 |
+                       (py < min.Y) << 2 | (py > max.Y) << 3 |
+                       (pz < min.Z) << 4 | (pz > max.Z) << 5 |
+                       (px != px || py != py || pz != pz) << 6;
+        }
+
+        for (s32 i = 0; i < m; i++) {
+            u8 a = codes[i], b = codes[i+1];
+            /* Both ends outside the same edge, or either is NaN (a gap in the line) */
+            if ((a & b) || ((a | b) & 0x40)) {
+                CLOSE_RUN();
+                continue;
+            }
+
+            HMM_Vec3 p0 = POINT(base + i);
+            HMM_Vec3 p1 = POINT(base + i + 1);
+            f32 t0 = 0, t1 = 1;
+            if (a | b) {
+                HMM_Vec3 d = HMM_SubV3(p1, p0);
+                if (!(clip_edge(-d.X, p0.X - min.X, &t0, &t1) && clip_edge(d.X, max.X - p0.X, &t0, &t1) &&
+                      clip_edge(-d.Y, p0.Y - min.Y, &t0, &t1) && clip_edge(d.Y, max.Y - p0.Y, &t0, &t1) &&
+                      clip_edge(-d.Z, p0.Z - min.Z, &t0, &t1) && clip_edge(d.Z, max.Z - p0.Z, &t0, &t1))) {
+                    CLOSE_RUN();
+                    continue;
+                }
+                if (t0 > 0) p0 = HMM_LerpV3(p0, t0, p1);
+                if (t1 < 1) p1 = HMM_LerpV3(p0, (t1 - t0)/(1 - t0), p1);
+            }
+
+            if (!open || t0 > 0) {
+                CLOSE_RUN();
+                out[count++] = p0;
+                open = 1;
+            }
+            out[count++] = p1;
+            if (t1 < 1) {
+                CLOSE_RUN();
+            }
+        }
+    }
+    CLOSE_RUN();
+#undef CLOSE_RUN
+#undef POINT
+
+    *run_count = runs;
+    return count;
+}
+
+Vec2 clamp_to_rect(Rect r, Vec2 p) {
+    p.x = (p.x < r.x)? r.x : ((p.x > r.x + r.w)? r.x + r.w : p.x);
+    p.y = (p.y < r.y)? r.y : ((p.y > r.y + r.h)? r.y + r.h : p.y);
+    return p;
+}
+
+Vec2 fvec2(f32 x, f32 y) { return (Vec2) {.x = x, .y = y};};
+Vec2 vec2_lerp(Vec2 a, Vec2 b, f32 m) { return (Vec2){ m*a.x + (1-m)*b.x, m*a.y + (1-m)*b.y }; }
+
+/* Critically damped spring toward target, independent of frame rate.
+   See "Critically Damped Ease-In/Ease-Out Smoothing", Game Programming Gems 4 */
+#define IMP_VIEW_SMOOTH_TIME 0.05
+f32 smooth_damp(f32 x, f32 target, f32 *velocity, f32 smooth_time, f32 dt) {
+    f32 omega = 2.0/smooth_time;
+    f32 k = omega*dt;
+    f32 e = 1.0/(1.0 + k + 0.48*k*k + 0.235*k*k*k);
+    f32 change = x - target;
+    f32 temp = (*velocity + omega*change)*dt;
+    *velocity = (*velocity - omega*temp)*e;
+    return target + (change + temp)*e;
+}
+
+/* Moves view toward target_view, snapping once the remaining motion is under eps.
+   Returns whether the view is still animating. */
+b32 animate_view(Rect *view, Rect target, Rect *velocity, f32 dt, f32 epsx, f32 epsy) {
+    f32 eps[4] = { epsx, epsy, epsx, epsy };
+    b32 animating = 0;
+    for (s32 i = 0; i < 4; i++) {
+        f32 *x = &(&view->x)[i];
+        f32 *v = &(&velocity->x)[i];
+        f32 t = (&target.x)[i];
+        *x = smooth_damp(*x, t, v, IMP_VIEW_SMOOTH_TIME, dt);
+        if (fabs(*x - t) < eps[i] && fabs(*v)*IMP_VIEW_SMOOTH_TIME < eps[i]) {
+            *x = t;
+            *v = 0;
+        } else {
+            animating = 1;
+        }
+    }
+    return animating;
+}
+
+/* Minor and major grid steps for a view extent, returns its log10 */
+f64 grid_steps(f64 extent, f64 *minor, f64 *major) {
+    f64 logscale = log(extent)/log(10);
     f64 intpart, fracpart = modf(logscale, &intpart);
     f64 step = pow(10, intpart-1);
     f64 majstep = step;
@@ -644,92 +2114,627 @@ void end_plot(Context *imp) {
     if (fracpart > 0.25) {
         majstep *= 2;
     }
+    *minor = step;
+    *major = majstep;
+    return logscale;
+}
+
+/* Count multiples of step in [min, min+len), first one is written to start */
+s32 grid_range(f64 min, f64 len, f64 step, f64 *start) {
+    f64 first = ceil(min/step);
+    *start = first*step;
+    return MAX(0, (s32)(ceil((min + len)/step) - first));
+}
+
+/* Emits lines at view positions start + i*step, vertical lines are at x positions */
+void draw_view_grid(Context *imp, Plot *plot, s32 orientation, f64 start, f64 step, s32 count, imp_Color c) {
+    if (orientation == IMP_GRID_VERTICAL) {
+        Vec2 origin = view_to_screen(plot, fvec2(start, plot->view.y + plot->view.h));
+        draw_grid(imp, origin, step/plot->view.w*plot->screen.w, plot->screen.h, count, orientation, c);
+    } else {
+        Vec2 origin = view_to_screen(plot, fvec2(plot->view.x, start));
+        draw_grid(imp, origin, -step/plot->view.h*plot->screen.h, plot->screen.w, count, orientation, c);
+    }
+}
+
+static str axis_ticks_label(AxisTicks *ticks, char *fmt, ...) {
+    str result = {.str = ticks->text + ticks->text_pos};
+    s32 room = IMP_TICK_TEXT_SIZE - ticks->text_pos;
+    va_list args;
+    va_start(args, fmt);
+    s32 len = (room > 1)? IMP_VSNSPRINTF(result.str, room, fmt, args) : 0;
+    va_end(args);
+    if (len > 0 && len < room) {
+        result.len = len;
+        ticks->text_pos += len + 1;
+    }
+    return result;
+}
 
+static void axis_ticks_push(AxisTicks *ticks, f64 pos, b32 major, str label, s64 number) {
+    if (ticks->count < IMP_MAX_TICKS) {
+        ticks->pos[ticks->count] = pos;
+        ticks->major[ticks->count] = major;
+        ticks->label[ticks->count] = label;
+        ticks->number[ticks->count] = number;
+        ticks->count++;
+    }
+}
+
+/* Label for m*10^k */
+static str axis_ticks_decade_label(AxisTicks *ticks, s32 m, s32 k, b32 negative) {
+    char *sign = negative? "-" : "";
+    if (abs(k) < 4) {
+        return axis_ticks_label(ticks, "%s%g", sign, m*pow(10, k));
+    }
+    return (m == 1)? axis_ticks_label(ticks, "%s1e%d", sign, k) : axis_ticks_label(ticks, "%s%de%d", sign, m, k);
+}
+
+/* Ticks for scaled view range [lo, hi] that is px pixels long. Majors are at powers of ten,
+   every step decades so labels stay apart, with minors at 2..9 times them when step is 1. */
+static void axis_ticks_update(AxisTicks *ticks, s32 scale, f32 linear, f64 lo, f64 hi, f32 px, s32 text_height) {
+    s32 first, last, decades;
+    if (scale == IMP_SCALE_LOG10) {
+        first = MAX(floor(lo), -330);
+        last = MIN(ceil(hi), 330);
+        decades = MAX(last - first, 1);
+    } else {
+        /* Decades of |v| past the linear part, on one or both sides of zero */
+        f64 v0 = unscale_value(scale, linear, lo), v1 = unscale_value(scale, linear, hi);
+        f64 vmax = MAX(fabs(v0), fabs(v1));
+        first = ceil(log10(linear));
+        last = (vmax > pow(10, first))? MIN(ceil(log10(vmax)), 330) : first;
+        decades = (last - first + 1)*((v0 < 0 && v1 > 0)? 2 : 1);
+    }
+    s32 max_labels = MIN(MAX(px/(3*text_height), 2), 16);
+    s32 step = MAX(1, (decades + max_labels - 1)/max_labels);
 
-    /* Set precision for label formatting */
-    /* TODO: Need a better way to do this. Should handle each axis seperately */
-    char *labelfmt;
-    s32 print_precision; {
-        /* "Good" range where we dont have many rounding errors */
-        if (logscale > -2 && logscale < 8) {
-            labelfmt = "%.7g";
+    if (ticks->built && !ticks->time && ticks->scale == scale && ticks->linear == linear &&
+        ticks->first == first && ticks->last == last && ticks->step == step) {
+        return;
+    }
+    ticks->built = 1;
+    ticks->time = 0;
+    ticks->scale = scale;
+    ticks->linear = linear;
+    ticks->first = first;
+    ticks->last = last;
+    ticks->step = step;
+    ticks->count = 0;
+    ticks->text_pos = 0;
+
+    /* Start on a multiple of step so the labelled decades don't change while panning */
+    s32 k0 = floor((f64)first/step)*step;
+    if (scale == IMP_SCALE_LOG10) {
+        b32 label_minor = (last - first <= 1);
+        for (s32 k = k0; k <= last; k += step) {
+            /* Labelled minors are numbered after their decade, 9 to a decade */
+            axis_ticks_push(ticks, k, 1, axis_ticks_decade_label(ticks, 1, k, 0), label_minor? 9*k : k/step);
+            for (s32 m = 2; step == 1 && k < last && m <= 9; m++) {
+                str label = label_minor? axis_ticks_decade_label(ticks, m, k, 0) : (str){0};
+                axis_ticks_push(ticks, k + log10(m), 0, label, 9*k + m - 1);
+            }
+        }
+    } else {
+        axis_ticks_push(ticks, 0, 1, axis_ticks_label(ticks, "0"), 0);
+        for (s32 k = k0; k <= last; k += step) {
+            for (s32 side = 0; side < 2; side++) {
+                f64 v = side? -pow(10, k) : pow(10, k);
+                s64 number = (k - k0)/step + 1;
+                if (k >= first) {
+                    axis_ticks_push(ticks, scale_value(scale, linear, v), 1, axis_ticks_decade_label(ticks, 1, k, side),
+                                    side? -number : number);
+                }
+                for (s32 m = 2; step == 1 && k < last && m <= 9; m++) {
+                    axis_ticks_push(ticks, scale_value(scale, linear, m*v), 0, (str){0}, 0);
+                }
+            }
+        }
+    }
+}
+
+enum {
+    IMP_TIME_SUBSECOND,
+    IMP_TIME_SECOND,
+    IMP_TIME_MINUTE,
+    IMP_TIME_HOUR,
+    IMP_TIME_DAY,
+    IMP_TIME_MONTH,
+};
+
+/* NOTE(lcf): major steps of a time axis, smallest first, and the number of minor steps in each.
+   Steps up to weeks are fixed lengths in seconds counted from offset, month steps (years are
+   12 of them) are counted in calendar months. */
+typedef struct TimeStep TimeStep;
+struct TimeStep {
+    f64 step;
+    u8 unit;
+    u8 minor;
+    f64 offset;
+};
+
+static const TimeStep imp_time_steps[] = {
+    {1e-6, IMP_TIME_SUBSECOND, 5, 0}, {2e-6, IMP_TIME_SUBSECOND, 2, 0}, {5e-6, IMP_TIME_SUBSECOND, 5, 0},
+    {1e-5, IMP_TIME_SUBSECOND, 5, 0}, {2e-5, IMP_TIME_SUBSECOND, 2, 0}, {5e-5, IMP_TIME_SUBSECOND, 5, 0},
+    {1e-4, IMP_TIME_SUBSECOND, 5, 0}, {2e-4, IMP_TIME_SUBSECOND, 2, 0}, {5e-4, IMP_TIME_SUBSECOND, 5, 0},
+    {1e-3, IMP_TIME_SUBSECOND, 5, 0}, {2e-3, IMP_TIME_SUBSECOND, 2, 0}, {5e-3, IMP_TIME_SUBSECOND, 5, 0},
+    {1e-2, IMP_TIME_SUBSECOND, 5, 0}, {2e-2, IMP_TIME_SUBSECOND, 2, 0}, {5e-2, IMP_TIME_SUBSECOND, 5, 0},
+    {0.1, IMP_TIME_SUBSECOND, 5, 0}, {0.2, IMP_TIME_SUBSECOND, 2, 0}, {0.5, IMP_TIME_SUBSECOND, 5, 0},
+    {1, IMP_TIME_SECOND, 5, 0}, {2, IMP_TIME_SECOND, 2, 0}, {5, IMP_TIME_SECOND, 5, 0},
+    {10, IMP_TIME_SECOND, 2, 0}, {15, IMP_TIME_SECOND, 3, 0}, {30, IMP_TIME_SECOND, 3, 0},
+    {60, IMP_TIME_MINUTE, 4, 0}, {120, IMP_TIME_MINUTE, 2, 0}, {300, IMP_TIME_MINUTE, 5, 0},
+    {600, IMP_TIME_MINUTE, 2, 0}, {900, IMP_TIME_MINUTE, 3, 0}, {1800, IMP_TIME_MINUTE, 3, 0},
+    {3600, IMP_TIME_HOUR, 4, 0}, {7200, IMP_TIME_HOUR, 2, 0}, {10800, IMP_TIME_HOUR, 3, 0},
+    {21600, IMP_TIME_HOUR, 2, 0}, {43200, IMP_TIME_HOUR, 2, 0},
+    {86400, IMP_TIME_DAY, 4, 0}, {172800, IMP_TIME_DAY, 2, 0},
+    /* 1970-01-05 was a Monday */
+    {604800, IMP_TIME_DAY, 7, 4*86400},
+    {1, IMP_TIME_MONTH, 0, 0}, {2, IMP_TIME_MONTH, 2, 0}, {3, IMP_TIME_MONTH, 3, 0}, {6, IMP_TIME_MONTH, 2, 0},
+    {12, IMP_TIME_MONTH, 4, 0}, {24, IMP_TIME_MONTH, 2, 0}, {60, IMP_TIME_MONTH, 5, 0}, {120, IMP_TIME_MONTH, 5, 0},
+    {240, IMP_TIME_MONTH, 2, 0}, {600, IMP_TIME_MONTH, 5, 0}, {1200, IMP_TIME_MONTH, 5, 0},
+};
+
+#define IMP_SECONDS_PER_MONTH 2629746.0
+
+/* NOTE(lcf): tables the time labels are put together from */
+static const char imp_month_names[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+static const s64 imp_pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+static s64 floor_div(s64 a, s64 b) {
+    return (a >= 0)? a/b : -((-a + b - 1)/b);
+}
+
+/* Days since 1970-01-01 to year, month (1-12) and day (1-31) in the proleptic Gregorian calendar.
+   See "chrono-Compatible Low-Level Date Algorithms", Howard Hinnant */
+static void time_civil(s64 days, s32 *year, s32 *month, s32 *day) {
+    days += 719468;
+    s64 era = floor_div(days, 146097);
+    s32 doe = days - era*146097;
+    s32 yoe = (doe - doe/1460 + doe/36524 - doe/146096)/365;
+    s32 doy = doe - (365*yoe + yoe/4 - yoe/100);
+    s32 mp = (5*doy + 2)/153;
+    *day = doy - (153*mp + 2)/5 + 1;
+    *month = (mp < 10)? mp + 3 : mp - 9;
+    *year = yoe + era*400 + (*month <= 2);
+}
+
+static s64 time_days_from_civil(s32 year, s32 month, s32 day) {
+    year -= (month <= 2);
+    s64 era = floor_div(year, 400);
+    s32 yoe = year - era*400;
+    s32 doy = (153*((month > 2)? month - 3 : month + 9) + 2)/5 + day - 1;
+    s32 doe = yoe*365 + yoe/4 - yoe/100 + doy;
+    return era*146097 + doe - 719468;
+}
+
+/* Seconds at the start of month k, counted from January of year 0 */
+static f64 time_from_month(s64 k) {
+    return time_days_from_civil(floor_div(k, 12), k - floor_div(k, 12)*12 + 1, 1)*86400.0;
+}
+
+static s32 time_step_digits(const TimeStep *s) {
+    return (s->unit == IMP_TIME_SUBSECOND)? MAX(1, (s32)ceil(-log10(s->step) - 1e-9)) : 0;
+}
+
+/* Longest label of a step in characters */
+static s32 time_step_chars(const TimeStep *s) {
+    switch (s->unit) {
+    case IMP_TIME_SUBSECOND: return 9 + time_step_digits(s);
+    case IMP_TIME_SECOND: return 8;
+    case IMP_TIME_MONTH: return 4;
+    }
+    return 6;
+}
+
+static char *time_put_year(char *p, s32 year) {
+    if (year < 0) {
+        *p++ = '-';
+        year = -year;
+    }
+    char digits[12];
+    s32 n = 0;
+    do { digits[n++] = '0' + year % 10; year /= 10; } while (year);
+    while (n < 4) digits[n++] = '0';
+    while (n) *p++ = digits[--n];
+    return p;
+}
+
+/* Label of a tick at t seconds, with digits decimals of a second. Put together from the tables
+   above without strftime or any format string parsing: times of day, dates at midnight, years on
+   new year. */
+static str time_label(AxisTicks *ticks, f64 t, s32 unit, s32 digits) {
+    char buf[32];
+    char *p = buf;
+    f64 whole = floor(t);
+    s64 sec = whole;
+    s64 frac = 0;
+    if (digits) {
+        frac = llround((t - whole)*imp_pow10[digits]);
+        if (frac >= imp_pow10[digits]) {
+            frac -= imp_pow10[digits];
+            sec++;
+        }
+    }
+    s64 days = floor_div(sec, 86400);
+    s32 tod = sec - days*86400;
+    s32 year, month, day;
+    time_civil(days, &year, &month, &day);
+
+#define PUT2(v) (memcpy(p, imp_digit_pairs + 2*(v), 2), p += 2)
+#define PUT_MONTH() (memcpy(p, imp_month_names + 3*(month - 1), 3), p += 3)
+    b32 midnight = (tod == 0 && frac == 0);
+    b32 new_year = midnight && month == 1 && day == 1;
+    if (unit == IMP_TIME_MONTH || (unit == IMP_TIME_DAY && new_year)) {
+        if (month == 1) p = time_put_year(p, year); else PUT_MONTH();
+    } else if (unit == IMP_TIME_DAY || ((unit == IMP_TIME_MINUTE || unit == IMP_TIME_HOUR) && midnight)) {
+        PUT_MONTH();
+        *p++ = ' ';
+        PUT2(day);
+    } else {
+        PUT2(tod/3600);
+        *p++ = ':';
+        PUT2(tod/60 % 60);
+        if (unit <= IMP_TIME_SECOND) {
+            *p++ = ':';
+            PUT2(tod % 60);
+        }
+        if (digits) {
+            *p++ = '.';
+            for (s32 i = digits - 1; i >= 0; i--, frac /= 10) {
+                p[i] = '0' + frac % 10;
+            }
+            p += digits;
+        }
+    }
+#undef PUT_MONTH
+#undef PUT2
+
+    str result = {0};
+    s32 len = p - buf;
+    if (ticks->text_pos + len + 1 <= IMP_TICK_TEXT_SIZE) {
+        result.str = ticks->text + ticks->text_pos;
+        result.len = len;
+        memcpy(result.str, buf, len);
+        result.str[len] = '\0';
+        ticks->text_pos += len + 1;
+    }
+    return result;
+}
+
+/* Ticks of a time axis showing [lo, hi] seconds over px pixels, with labels char_w pixels a
+   character. The step is the smallest that keeps labels apart. Steps are cached in blocks at
+   least twice as long as the view, so panning only formats labels again once per block. */
+static void time_ticks_update(AxisTicks *ticks, f64 lo, f64 hi, f32 px, f32 char_w) {
+    s32 count = sizeof(imp_time_steps)/sizeof(imp_time_steps[0]);
+    f64 px_per_second = px/MAX(hi - lo, 1e-12);
+    f64 seconds = 0;
+    s32 e = 0;
+    for (; e < count; e++) {
+        const TimeStep *s = imp_time_steps + e;
+        seconds = (s->unit == IMP_TIME_MONTH)? s->step*IMP_SECONDS_PER_MONTH : s->step;
+        if (seconds*px_per_second >= (time_step_chars(s) + 3)*char_w || e == count - 1) {
+            break;
+        }
+    }
+    const TimeStep *s = imp_time_steps + e;
+    s32 block = 8;
+    while (block < (IMP_MAX_TICKS - 1)/2 && block <= (hi - lo)/seconds + 1) {
+        block *= 2;
+    }
+
+    s64 k;
+    if (s->unit == IMP_TIME_MONTH) {
+        s32 year, month, day;
+        time_civil(floor(lo/86400), &year, &month, &day);
+        k = floor_div(year*12 + month - 1, s->step);
+    } else {
+        k = floor((lo - s->offset)/s->step);
+    }
+    /* The view starts in [first, first + block) and is shorter than a block */
+    s64 first = floor_div(k, block)*block;
+    s64 last = first + 2*block;
+
+    if (ticks->built && ticks->time && ticks->step == e && ticks->first == first && ticks->last == last) {
+        return;
+    }
+    ticks->built = 1;
+    ticks->time = 1;
+    ticks->step = e;
+    ticks->first = first;
+    ticks->last = last;
+    ticks->count = 0;
+    ticks->text_pos = 0;
+
+    /* NOTE(lcf): leave minors out before they'd push majors in view out of the buffer */
+    s32 minor = ((last - first + 1)*s->minor <= IMP_MAX_TICKS)? s->minor : 1;
+    s32 digits = time_step_digits(s);
+    for (k = first; k <= last; k++) {
+        if (s->unit == IMP_TIME_MONTH) {
+            s64 months = k*(s64)s->step;
+            f64 t = time_from_month(months);
+            axis_ticks_push(ticks, t, 1, time_label(ticks, t, s->unit, digits), k);
+            for (s32 j = 1; j < minor; j++) {
+                axis_ticks_push(ticks, time_from_month(months + j*(s64)s->step/minor), 0, (str){0}, 0);
+            }
         } else {
-            labelfmt = "%.1e";
+            f64 t = s->offset + k*s->step;
+            axis_ticks_push(ticks, t, 1, time_label(ticks, t, s->unit, digits), k);
+            for (s32 j = 1; j < minor; j++) {
+                axis_ticks_push(ticks, t + j*s->step/minor, 0, (str){0}, 0);
+            }
         }
     }
-        
-    /* Draw Minor Grid */
-    {
-        f32 stepx = step;
-        f32 stepy = step;
+}
+
+/* Log, symlog and time axes take their grid and labels from plot->ticks */
+static b32 axis_has_tick_cache(Plot *plot, s32 axis) {
+    s32 scale = axis? plot->scale_y : plot->scale_x;
+    return scale != IMP_SCALE_LINEAR || (plot->flags & (axis? IMP_PLOT_TIME_Y : IMP_PLOT_TIME_X));
+}
+
+/* Grid lines of an axis with cached ticks, 0 for x and 1 for y */
+void draw_tick_grid(Context *imp, Plot *plot, s32 axis) {
+    AxisTicks *ticks = plot->ticks + axis;
+    s32 scale = axis? plot->scale_y : plot->scale_x;
+    f64 origin = (&plot->origin_x)[axis];
+    f64 lo = origin + (&plot->view.x)[axis];
+    f64 hi = lo + (&plot->view.w)[axis];
+    f32 px = (&plot->screen.w)[axis];
+    if (scale == IMP_SCALE_LINEAR) {
+        time_ticks_update(ticks, lo, hi, px, imp->text_width_fun(imp->text_width_data, "0", 1));
+    } else {
+        axis_ticks_update(ticks, scale, plot_symlog_linear(plot), lo, hi, px, imp->text_height);
+    }
+
+    for (s32 i = 0; i < ticks->count; i++) {
+        if (ticks->pos[i] >= lo && ticks->pos[i] <= hi) {
+            draw_view_grid(imp, plot, axis? IMP_GRID_HORIZONTAL : IMP_GRID_VERTICAL, ticks->pos[i] - origin, 1, 1,
+                           color(ticks->major[i]? GRIDMAJOR : GRIDMINOR));
+        }
+    }
+}
+
+static void label_grid_clear(LabelGrid *grid, Rect screen) {
+    grid->screen = screen;
+    grid->cell_w = MAX(screen.w/IMP_LABEL_GRID_SIZE, 1);
+    grid->cell_h = MAX(screen.h/IMP_LABEL_GRID_SIZE, 1);
+    memset(grid->rows, 0, sizeof(grid->rows));
+}
+
+/* Cells whose centers are inside r, or the one under its center for small r. Rows r0..r1 with
+   the columns in mask. */
+static void label_grid_cells(LabelGrid *grid, Rect r, s32 *r0, s32 *r1, u64 *mask) {
+    s32 last = IMP_LABEL_GRID_SIZE - 1;
+    f32 x0 = (r.x - grid->screen.x)/grid->cell_w - 0.5f, x1 = x0 + r.w/grid->cell_w;
+    f32 y0 = (r.y - grid->screen.y)/grid->cell_h - 0.5f, y1 = y0 + r.h/grid->cell_h;
+    s32 c0 = MAX(ceil(x0), 0), c1 = MIN(floor(x1), last);
+    *r0 = MAX(ceil(y0), 0);
+    *r1 = MIN(floor(y1), last);
+    if (c0 > c1) {
+        c0 = c1 = MIN(MAX(floor((x0 + x1)/2 + 0.5f), 0), last);
+    }
+    if (*r0 > *r1) {
+        *r0 = *r1 = MIN(MAX(floor((y0 + y1)/2 + 0.5f), 0), last);
+    }
+    *mask = ((c1 - c0 == last)? ~(u64)0 : (((u64)1 << (c1 - c0 + 1)) - 1)) << c0;
+}
+
+/* Claims the cells of r if none are taken yet */
+static b32 label_grid_claim(LabelGrid *grid, Rect r) {
+    s32 r0, r1;
+    u64 mask;
+    label_grid_cells(grid, r, &r0, &r1, &mask);
+    for (s32 i = r0; i <= r1; i++) {
+        if (grid->rows[i] & mask) {
+            return 0;
+        }
+    }
+    for (s32 i = r0; i <= r1; i++) {
+        grid->rows[i] |= mask;
+    }
+    return 1;
+}
+
+/* Text that is only drawn if it doesn't overlap labels drawn before it in this plot */
+static b32 draw_label(Context *imp, Vec2 pos, str text, f32 w) {
+    Rect r = {.x = pos.x, .y = pos.y, .w = w, .h = imp->text_height};
+    if (!label_grid_claim(&imp->label_grid, r)) {
+        return 0;
+    }
+    draw_text(imp, pos, text, w, color(TEXT));
+    return 1;
+}
 
-        f32 startx, starty;
-        startx = copysign(floor(fabs(plot->view.x)/stepx)*stepx, plot->view.x);
-        starty = copysign(floor(fabs(plot->view.y)/stepy)*stepy, plot->view.y);
+/* NOTE(lcf): labels along one axis, placed before any is drawn so they can be thinned out */
+#define IMP_MAX_ROW_LABELS 64
+typedef struct LabelRow LabelRow;
+struct LabelRow {
+    s32 count;
+    s64 index[IMP_MAX_ROW_LABELS];
+    Vec2 pos[IMP_MAX_ROW_LABELS];
+    f32 w[IMP_MAX_ROW_LABELS];
+    str text[IMP_MAX_ROW_LABELS];
+};
 
-        for (f32 x = startx; x < plot->view.x + plot->view.w; x += stepx ) {
-            if (x < plot->view.x) continue;
-            draw_grid_line(imp,
-                      view_to_screen(plot, fvec2(x, plot->view.y)),
-                      view_to_screen(plot, fvec2(x, plot->view.y + plot->view.h)),
-                      color(GRIDMINOR)
-                );
+/* Draws a row of labels ordered along an axis. If neighbours would overlap only every stride'th
+   is kept, counted by index so the same ones stay while panning, then labels landing on others
+   are dropped. */
+static void draw_label_row(Context *imp, LabelRow *row) {
+    f32 pad = imp->text_height/4.0f;
+    s32 stride = 1;
+    for (; stride < row->count; stride++) {
+        b32 apart = 1;
+        for (s32 i = 0; apart && i + stride < row->count; i++) {
+            s32 j = i + stride;
+            apart = (row->pos[i].x + row->w[i] + pad <= row->pos[j].x || row->pos[j].x + row->w[j] + pad <= row->pos[i].x ||
+                     row->pos[i].y + imp->text_height + pad <= row->pos[j].y || row->pos[j].y + imp->text_height + pad <= row->pos[i].y);
+        }
+        if (apart) {
+            break;
         }
+    }
+    for (s32 i = 0; i < row->count; i++) {
+        if (row->index[i] - floor_div(row->index[i], stride)*stride == 0) {
+            draw_label(imp, row->pos[i], row->text[i], row->w[i]);
+        }
+    }
+    row->count = 0;
+}
 
+/* Places the label of a tick at view position v of axis 0 (x) or 1 (y) in row. Labels sit next to
+   the other axis, or on the plot edge if it's out of view or log scaled. */
+void push_tick_label(Context *imp, Plot *plot, LabelRow *row, s64 index, s32 axis, f64 v, str label, Rect margin) {
+    if (row->count >= IMP_MAX_ROW_LABELS) {
+        return;
+    }
+    f32 w;
+    Vec2 p;
+    if (axis == 0) {
+        f32 y = (plot->scale_y == IMP_SCALE_LOG10)? plot->view.y : -plot->origin_y;
+        p = view_to_screen(plot, (Vec2){v, y});
+        p.y += imp->text_height*.05;
+        p = position_text(imp, p, label, TEXT_CENTERED, &w);
+        p = clamp_to_rect(margin, p);
+        p.x += w;
+        p = clamp_to_rect(margin, p);
+        p.x -= w;
+    } else {
+        b32 left = (plot->scale_x == IMP_SCALE_LOG10) || plot->view.x > -plot->origin_x;
+        f32 x = (plot->scale_x == IMP_SCALE_LOG10)? plot->view.x : -plot->origin_x;
+        p = view_to_screen(plot, (Vec2){x, v});
+        p = position_text(imp, p, label, left? TEXT_LEFT : TEXT_RIGHT, &w);
+        if (left) {
+            p = clamp_to_rect(margin, p);
+        } else {
+            p.x += w;
+            p = clamp_to_rect(margin, p);
+            p.x -= w;
+        }
+    }
+    row->index[row->count] = index;
+    row->pos[row->count] = p;
+    row->w[row->count] = w;
+    row->text[row->count] = label;
+    row->count++;
+}
 
-        for (f32 y = starty; y < plot->view.y + plot->view.h; y += stepy ) {
-            if (y < plot->view.y) continue;
-            draw_grid_line(imp,
-                      view_to_screen(plot, fvec2(plot->view.x, y)),
-                      view_to_screen(plot, fvec2(plot->view.x + plot->view.w, y)),
-                      color(GRIDMINOR)
-                );
+/* Labels of an axis with cached ticks, thinned by their step numbers so the same ones stay
+   up while panning across cache blocks. */
+void draw_tick_labels(Context *imp, Plot *plot, s32 axis, Rect margin) {
+    AxisTicks *ticks = plot->ticks + axis;
+    f64 origin = (&plot->origin_x)[axis];
+    f64 lo = origin + (&plot->view.x)[axis];
+    f64 hi = lo + (&plot->view.w)[axis];
+    LabelRow row;
+    row.count = 0;
+    for (s32 i = 0; i < ticks->count; i++) {
+        if (ticks->label[i].len > 0 && ticks->pos[i] >= lo && ticks->pos[i] <= hi) {
+            push_tick_label(imp, plot, &row, ticks->number[i], axis, ticks->pos[i] - origin, ticks->label[i], margin);
+        }
+    }
+    draw_label_row(imp, &row);
+}
+
+void end_plot(Context *imp) {
+    Plot *plot = current_plot(imp);
+    draw_rect(imp, plot->screen, color(PLOTBG));
+    plot->dragging = 0;
+
+    if (point_in_rect(plot->view, plot->mouse)) {
+        /* Drag */
+        Vec2 mouse_delta = {plot->mouse.x - plot->target_view.x, plot->mouse.y - plot->target_view.y};
+        if (imp->input.mouse_pressed) {
+            plot->drag.x = plot->target_view.x + mouse_delta.x;
+            plot->drag.y = plot->target_view.y + mouse_delta.y;
+        }
+        if (imp->input.mouse_down) {
+            plot->dragging = 1;
+            plot->target_view.x = plot->drag.x - mouse_delta.x;
+            plot->target_view.y = plot->drag.y - mouse_delta.y;
+        }
+
+        /* Zoom */
+        if (abs(imp->input.mouse_scroll) > 0.01) {
+            Vec2 center = {plot->target_view.x + plot->target_view.w/2, plot->target_view.y + plot->target_view.h/2};
+            if (imp->input.mouse_scroll > 0) {
+                plot->target_view.w = plot->target_view.w*1.05*imp->input.mouse_scroll;
+                plot->target_view.h = plot->target_view.h*1.05*imp->input.mouse_scroll;
+            } else {
+                plot->target_view.w = plot->target_view.w/(1.05*-imp->input.mouse_scroll);
+                plot->target_view.h = plot->target_view.h/(1.05*-imp->input.mouse_scroll);
+            }
+            plot->target_view.x = center.x - plot->target_view.w/2;
+            plot->target_view.y = center.y - plot->target_view.h/2;
+        }
+    }
+
+    /* Anything closer than a quarter pixel to the target is not visible as motion */
+    {
+        f32 epsx = 0.25*plot->target_view.w/plot->screen.w;
+        f32 epsy = 0.25*plot->target_view.h/plot->screen.h;
+        plot->animating = animate_view(&plot->view, plot->target_view, &plot->view_velocity, imp->input.dt, epsx, epsy);
+        imp->animating |= plot->animating;
+    }
+
+    f64 maxdim = MAX(plot->view.w,plot->view.h);
+    f64 stepx, majstepx;
+    grid_steps(maxdim, &stepx, &majstepx);
+    f64 stepy = stepx, majstepy = majstepx;
+    if (plot_free_aspect(plot)) {
+        grid_steps(plot->view.w, &stepx, &majstepx);
+        grid_steps(plot->view.h, &stepy, &majstepy);
+    }
+
+
+    /* NOTE(lcf): grid lines and labels are placed in data units so they stay on round values of
+       rebased axes, which can be zoomed far into large numbers. Their labels get enough digits
+       to tell major steps apart. */
+    f64 ox = plot->origin_x, oy = plot->origin_y;
+    TickFormat formatx = imp_tick_format(majstepx, MAX(fabs(ox + plot->view.x), fabs(ox + plot->view.x + plot->view.w)));
+    TickFormat formaty = imp_tick_format(majstepy, MAX(fabs(oy + plot->view.y), fabs(oy + plot->view.y + plot->view.h)));
+
+    /* Draw Minor Grid */
+    {
+        f64 startx, starty;
+        s32 nx = grid_range(ox + plot->view.x, plot->view.w, stepx, &startx);
+        s32 ny = grid_range(oy + plot->view.y, plot->view.h, stepy, &starty);
+
+        if (!axis_has_tick_cache(plot, 0)) {
+            draw_view_grid(imp, plot, IMP_GRID_VERTICAL, startx - ox, stepx, nx, color(GRIDMINOR));
+        }
+        if (!axis_has_tick_cache(plot, 1)) {
+            draw_view_grid(imp, plot, IMP_GRID_HORIZONTAL, starty - oy, stepy, ny, color(GRIDMINOR));
         }
     }
     
     /* Draw Major Grid and Labels */
-    b32 xaxis_visible = point_in_rect(plot->view, (Vec2) {plot->view.x + plot->view.w/2, 0});
-    b32 yaxis_visible = point_in_rect(plot->view, (Vec2) {0, plot->view.y + plot->view.h/2});
+    b32 xaxis_visible = point_in_rect(plot->view, (Vec2) {plot->view.x + plot->view.w/2, -oy});
+    b32 yaxis_visible = point_in_rect(plot->view, (Vec2) {-ox, plot->view.y + plot->view.h/2});
     {
-        f32 stepx = majstep;
-        f32 stepy = majstep;
-
-        f32 startx, starty;
-        startx = copysign(floor(fabs(plot->view.x)/stepx)*stepx, plot->view.x);
-        starty = copysign(floor(fabs(plot->view.y)/stepy)*stepy, plot->view.y);
-
-        for (f32 x = startx; x < plot->view.x + plot->view.w; x += stepx ) {
-            if (x < plot->view.x) continue;
-            draw_grid_line(imp,
-                      view_to_screen(plot, fvec2(x, plot->view.y)),
-                      view_to_screen(plot, fvec2(x, plot->view.y + plot->view.h)),
-                      color(GRIDMAJOR)
-                );
-        }
-
-        for (f32 y = starty; y < plot->view.y + plot->view.h; y += stepy ) {
-            if (y < plot->view.y) continue;
-            draw_grid_line(imp,
-                      view_to_screen(plot, fvec2(plot->view.x, y)),
-                      view_to_screen(plot, fvec2(plot->view.x + plot->view.w, y)),
-                      color(GRIDMAJOR)
-                );
-        }
-
-        if (yaxis_visible) {
-            draw_grid_line(imp,
-                      view_to_screen(plot, fvec2(0, plot->view.y)),
-                      view_to_screen(plot, fvec2(0, plot->view.y+plot->view.h)),
-                      color(GRIDAXES)
-                );
-        }
-
-        if (xaxis_visible) {
-        draw_grid_line(imp,
-                  view_to_screen(plot, fvec2(plot->view.x, 0)),
-                  view_to_screen(plot, fvec2(plot->view.x+plot->view.w, 0)),
-                  color(GRIDAXES)
-            );
+        f64 startx, starty;
+        s32 nx = grid_range(ox + plot->view.x, plot->view.w, majstepx, &startx);
+        s32 ny = grid_range(oy + plot->view.y, plot->view.h, majstepy, &starty);
+
+        if (!axis_has_tick_cache(plot, 0)) {
+            draw_view_grid(imp, plot, IMP_GRID_VERTICAL, startx - ox, majstepx, nx, color(GRIDMAJOR));
+        } else {
+            draw_tick_grid(imp, plot, 0);
+            nx = 0;
+        }
+        if (!axis_has_tick_cache(plot, 1)) {
+            draw_view_grid(imp, plot, IMP_GRID_HORIZONTAL, starty - oy, majstepy, ny, color(GRIDMAJOR));
+        } else {
+            draw_tick_grid(imp, plot, 1);
+            ny = 0;
+        }
+
+        /* NOTE(lcf): 0 on a log axis is 1, not an axis */
+        if (yaxis_visible && plot->scale_x != IMP_SCALE_LOG10) {
+            draw_view_grid(imp, plot, IMP_GRID_VERTICAL, -ox, 1, 1, color(GRIDAXES));
+        }
+
+        if (xaxis_visible && plot->scale_y != IMP_SCALE_LOG10) {
+            draw_view_grid(imp, plot, IMP_GRID_HORIZONTAL, -oy, 1, 1, color(GRIDAXES));
         }
  
         Rect screen_margin = plot->screen;
@@ -737,55 +2742,120 @@ void end_plot(Context *imp) {
         screen_margin.x += imp->text_height/2;
         screen_margin.w -= imp->text_height;
 
-        for (f32 x = startx; x < plot->view.x + plot->view.w; x += stepx ) {
-            if (x < plot->view.x) continue;
+        /* NOTE(lcf): the stats line claims its place first so tick labels under it are dropped,
+           it's drawn over the data below */
+        label_grid_clear(&imp->label_grid, plot->screen);
+        str stats_label = {0};
+        Vec2 stats_pos;
+        f32 stats_w;
+        if ((plot->flags & IMP_PLOT_DRAW_STATS) && plot->data[0].n > 0) {
+            s32 first, end;
+            imp_visible_range(plot, 0, &first, &end);
+            DataStats stats = imp_data_stats(plot, 0, first, end);
+            if (stats.count > 0) {
+                stats_label = strf(imp, "n %d  min %.4g  max %.4g  mean %.4g  rms %.4g", stats.count, stats.min,
+                                   stats.max, stats.sum/stats.count, sqrt(stats.sum2/stats.count));
+                stats_pos = (Vec2){plot->screen.x + imp->text_height/2, plot->screen.y + imp->text_height/4};
+                stats_pos = position_text(imp, stats_pos, stats_label, TEXT_LEFT, &stats_w);
+                label_grid_claim(&imp->label_grid, (Rect){.x = stats_pos.x, .y = stats_pos.y, .w = stats_w, .h = imp->text_height});
+            }
+        }
+
+        LabelRow row;
+        row.count = 0;
+        for (s32 i = 0; i < nx; i++) {
+            f64 x = startx + i*majstepx;
             /* Don't label origin  */
-            if (fabs(x) < 0.01*step) {
+            if (fabs(x) < 0.01*stepx) {
                 continue;
             }
 
-            /* Draw Label */
-            str label = strf(imp, labelfmt, x);
-            Vec2 p = view_to_screen(plot, (Vec2){x, 0});
-            p.y += imp->text_height*.05;
-            f32 w;
-            p = position_text(imp, p, label, TEXT_CENTERED, &w);
-            p = clamp_to_rect(screen_margin, p);
-            p.x += w;
-            p = clamp_to_rect(screen_margin, p);
-            p.x -= w;
-            draw_text(imp, p, label, w, color(TEXT));
+            str label = imp_tick_label(imp, x, formatx);
+            push_tick_label(imp, plot, &row, llround(x/majstepx), 0, x - ox, label, screen_margin);
         }
+        draw_label_row(imp, &row);
 
-
-        for (f32 y = starty; y < plot->view.y + plot->view.h; y += stepy ) {
-            if (y < plot->view.y) continue;
-            if (fabs(y) < 0.01*step) {
+        for (s32 i = 0; i < ny; i++) {
+            f64 y = starty + i*majstepy;
+            if (fabs(y) < 0.01*stepy) {
                 continue;
             }
 
-            /* Draw Label */
-            str label = strf(imp, labelfmt, y);
-            Vec2 p = view_to_screen(plot, (Vec2){0, y});
-            f32 w;
-            p = position_text(imp, p, label, plot->view.x > 0? TEXT_LEFT : TEXT_RIGHT, &w);
-            if (plot->view.x > 0) {
-                p = clamp_to_rect(screen_margin, p);
-            } else {
-                p.x += w;
-                p = clamp_to_rect(screen_margin, p);
-                p.x -= w;
+            str label = imp_tick_label(imp, y, formaty);
+            push_tick_label(imp, plot, &row, llround(y/majstepy), 1, y - oy, label, screen_margin);
+        }
+        draw_label_row(imp, &row);
+
+        if (axis_has_tick_cache(plot, 0)) {
+            draw_tick_labels(imp, plot, 0, screen_margin);
+        }
+        if (axis_has_tick_cache(plot, 1)) {
+            draw_tick_labels(imp, plot, 1, screen_margin);
+        }
+
+        draw_data(imp, plot, imp_shown_data(plot, 0));
+
+        /* Highlight the point under the mouse */
+        plot->hover_series = -1;
+        if (point_in_rect(plot->view, plot->mouse)) {
+            f32 radius = IMP_HOVER_RADIUS;
+            for (s32 i = 0; i < IMP_MAX_DATA; i++) {
+                s32 k = imp_nearest_point(plot, i, plot->mouse, radius);
+                if (k >= 0) {
+                    Data shown = imp_shown_data(plot, i);
+                    Vec2 q = view_to_screen(plot, (Vec2){shown.x[k], shown.y[k]});
+                    Vec2 m = view_to_screen(plot, plot->mouse);
+                    radius = sqrt((q.x - m.x)*(q.x - m.x) + (q.y - m.y)*(q.y - m.y));
+                    plot->hover_series = i;
+                    plot->hover_index = k;
+                }
             }
-            
+        }
+        if (plot->hover_series >= 0) {
+            Data *data = plot->data + plot->hover_series;
+            Data shown = imp_shown_data(plot, plot->hover_series);
+            s32 k = plot->hover_index;
+            draw_highlight(imp, plot, plot->hover_series, k);
+            str label = strf(imp, "(%g, %g)", data_value(data, data->x, k), data_value(data, data->y, k));
+            Vec2 p = view_to_screen(plot, (Vec2){shown.x[k], shown.y[k]});
+            p.y -= 1.5*imp->text_height;
+            f32 w;
+            p = position_text(imp, p, label, TEXT_CENTERED, &w);
             draw_text(imp, p, label, w, color(TEXT));
         }
 
-        draw_data(imp, plot, plot->data[0]);
+        if (stats_label.len > 0) {
+            draw_text(imp, stats_pos, stats_label, stats_w, color(TEXT));
+        }
     }
 
     plot->last_command = imp->command_pos;
     plot->next_command = plot->first_command;
 
+    /* Hash commands to detect changes since last frame. Text is hashed by content and not by
+       text.str, since the label strings move around in char_buffer. */
+    {
+        u32 h = HASH_INITIAL;
+        for (s32 pos = plot->first_command; pos < plot->last_command; ) {
+            Command *cmd = (Command *)(imp->command_buffer + pos);
+            if (cmd->type == IMP_COMMAND_TEXT) {
+                hash_words(&h, cmd, offsetof(TextCommand, text));
+                hash_words(&h, &cmd->text.text.len, sizeof(cmd->text.text.len));
+                for (s32 i = 0; i < cmd->text.text.len; i++) {
+                    h ^= (u8)cmd->text.text.str[i];
+                    h *= 16777619;
+                }
+            } else {
+                hash_words(&h, cmd, cmd->base.size);
+            }
+            pos += cmd->base.size;
+        }
+
+        plot->changed = (h != plot->command_hash);
+        plot->command_hash = h;
+        imp->changed |= plot->changed;
+    }
+
     if (imp->prev_plot) {
         imp->prev_plot->next = plot - imp->plot;
     }
@@ -803,28 +2873,43 @@ Plot * imp_next_plot(Context *imp) {
     Plot *plot = imp->first_plot;
 
     if (plot) {
-        imp->first_plot = (plot->next > 0)? imp->plot + plot->next : 0;
+        imp->first_plot = (plot->next >= 0)? imp->plot + plot->next : 0;
     }
 
     return plot;
 }
 
-b32 imp_next_plot_command(Context *imp, Plot *plot, Command *cmd) {
-    b32 out = 0;
-    if (plot) {
-        *cmd = imp->command_buffer[plot->next_command++];
-        out = plot->next_command <= plot->last_command;
+/* NOTE(lcf): like mu_next_command, commands are read in place rather than copied out */
+b32 imp_next_plot_command(Context *imp, Plot *plot, Command **cmd) {
+    if (plot && plot->next_command < plot->last_command) {
+        *cmd = (Command *)(imp->command_buffer + plot->next_command);
+        plot->next_command += (*cmd)->base.size;
+        return 1;
     }
-    return out;
+    return 0;
+}
+
+Plot *command_plot(Context *imp, Command *cmd) {
+    return imp->plot + (cmd->base.plot & (IMP_MAX_PLOTS-1));
 }
 
-b32 imp_next_command(Context *imp, Command *cmd) {
+/* NOTE(lcf): late latching. Commands are built for the mouse sampled in imp_begin, which
+   is a whole frame old by the time they are submitted. A backend can read the mouse again
+   right before drawing a dragged plot's data and grid and shift them by this many pixels. */
+Vec2 imp_late_pan_offset(Context *imp, Plot *plot, Vec2 latest_mouse) {
+    if (!plot->dragging) {
+        return (Vec2){0};
+    }
+    return (Vec2){latest_mouse.x - imp->input.mouse.x, latest_mouse.y - imp->input.mouse.y};
+}
+
+b32 imp_next_command(Context *imp, Command **cmd) {
     Plot *plot = imp->first_plot;
 
-    if (plot && plot->next_command > plot->last_command) {
-        plot = imp_next_plot(imp);
+    while (plot && plot->next_command >= plot->last_command) {
+        imp_next_plot(imp);
+        plot = imp->first_plot;
     }
 
     return imp_next_plot_command(imp, plot, cmd);
 }
-
@@ -15,8 +15,6 @@
 
    - support multiple Y (2D) or Z (3D) axis scales on same plotbox.
 
-   - software clipping with linear projection.
-
    - multiple grid levels, zoomable grid + labels
    - keep consistent label formatting for zoom level
 
@@ -28,6 +26,8 @@
    - need a big restructuring of damn near everything.
  */
 
+#include <string.h>
+#include <float.h>
 #include "third_party/raylib/raylib.h"
 #include "third_party/raylib/rlgl.h"
 #include "third_party/microui/microui.h"
@@ -39,6 +39,19 @@ extern void glBindTexture(int, unsigned);
 extern void glTexImage2D(int, int, int, unsigned, unsigned, int, int, int, const void*);
 extern void glTexParameteriv(int, int, const int*);
 extern void glTexParameteri(int, int, int);
+extern void glDrawArrays(int, int, int);
+extern void glDrawElements(int, int, int, const void *);
+
+#ifdef _WIN32
+/* NOTE: windows.h clashes with raylib (Rectangle, CloseWindow, DrawText...), declare what we need */
+__declspec(dllimport) void * __stdcall CreateThread(void *, size_t, unsigned long (__stdcall *)(void *), void *, unsigned long, unsigned long *);
+__declspec(dllimport) unsigned long __stdcall WaitForSingleObject(void *, unsigned long);
+__declspec(dllimport) int __stdcall CloseHandle(void *);
+typedef void *ImpThread;
+#else
+#include <pthread.h>
+typedef pthread_t ImpThread;
+#endif
 
 enum { ATLAS_WHITE = MU_ICON_MAX, ATLAS_FONT };
 enum { ATLAS_WIDTH = 256, ATLAS_HEIGHT = 256 };
@@ -104,6 +117,36 @@ enum {
     IMP_PRESET_3D            = (IMP_AXIS_ALL | IMP_GRID_ALL),
 
 };
+/* NOTE: everything the grid lines depend on. Compared bytewise, so build it zeroed. */
+typedef struct ImpGridKey {
+    u64 flags;
+    HMM_Vec3 plot_min;
+    HMM_Vec3 plot_max;
+    HMM_Vec3 plot_scale;
+    HMM_Vec3 view_radius;
+    HMM_Vec3 billboard_z;
+    f32 line_size;
+    s32 side[3];
+} ImpGridKey;
+
+/* NOTE: grid lines are built into one vertex buffer and redrawn from it until the key changes */
+typedef struct ImpGridVertex {
+    HMM_Vec3 pos;
+    HMM_Vec2 uv;
+    Color color;
+} ImpGridVertex;
+
+typedef struct ImpGridCache {
+    ImpGridKey key;
+    b32 valid;
+    ImpGridVertex *verts;
+    s32 count;
+    s32 capacity;
+    u32 vao;
+    u32 vbo;
+    s32 gpu_capacity;
+} ImpGridCache;
+
 typedef struct ImpPlot {
     u64 flags;
 
@@ -140,14 +183,16 @@ typedef struct ImpPlot {
 
     f32 line_size_f;
     f32 text_size_f;
-    str xtick_format;
-    str ytick_format;
-    str ztick_format;
+    TickFormat xtick_format;
+    TickFormat ytick_format;
+    TickFormat ztick_format;
 
     s32 plotting;
     
     HMM_Vec3 text_percent_offset;
     f32 grid_margin;
+
+    ImpGridCache grid;
 } ImpPlot;
 
 enum {
@@ -182,15 +227,14 @@ static inline void ImpDrawTexQuadFromAtlas(ImpDrawPlane p, Rectangle tex, Color
     rlEnd();
 }
 
-void ImpDrawLine(ImpPlot *plot, HMM_Vec3 start, HMM_Vec3 end, Color color, float thickness) {
+/* Vector across a billboarded line along dir, thickness wide */
+static HMM_Vec3 ImpLineWidthDir(ImpPlot *plot, HMM_Vec3 dir, float thickness) {
     f32 size = plot->line_size_f*thickness;
 
     if (plot->plotting) {
         size *= plot->zoom;
     }
 
-    ImpDrawPlane p;
-    HMM_Vec3 dir = HMM_SubV3(end, start);
     HMM_Vec3 udir = HMM_NormV3(dir);
 
     HMM_Vec3 to_camera;
@@ -205,7 +249,13 @@ void ImpDrawLine(ImpPlot *plot, HMM_Vec3 start, HMM_Vec3 end, Color color, float
     HMM_Vec3 width_dir = HMM_NormV3(HMM_Cross(udir, to_camera));
     /* color.r = 255.0*width_dir.X; color.g = 255.0*width_dir.Y; color.b = 255.0*width_dir.Z; */
 
-    width_dir = HMM_MulV3F(width_dir, size);
+    return HMM_MulV3F(width_dir, size);
+}
+
+void ImpDrawLine(ImpPlot *plot, HMM_Vec3 start, HMM_Vec3 end, Color color, float thickness) {
+    ImpDrawPlane p;
+    HMM_Vec3 dir = HMM_SubV3(end, start);
+    HMM_Vec3 width_dir = ImpLineWidthDir(plot, dir, thickness);
     p.bl = HMM_SubV3(start, HMM_MulV3F(width_dir, 0.5));
     p.r = dir;
     p.u = width_dir;
@@ -213,26 +263,1311 @@ void ImpDrawLine(ImpPlot *plot, HMM_Vec3 start, HMM_Vec3 end, Color color, float
     ImpDrawTexQuadFromAtlas(p, r, color);
 }
 
+/* NOTE: data space copy of a series on the gpu. Panning and zooming only change the
+   matrix it is drawn with. Bump version when points change, appending only grows n. */
+typedef struct ImpSeriesCache {
+    u32 vao;
+    u32 vbo;
+    s32 capacity;
+    s32 uploaded;
+    u32 version;
+} ImpSeriesCache;
+
+void ImpUploadSeries(ImpSeriesCache *cache, HMM_Vec3 *points, s32 n, u32 version) {
+    if (cache->vao && cache->version == version && n >= cache->uploaded && n <= cache->capacity) {
+        /* Appended tail only */
+        if (n > cache->uploaded) {
+            rlUpdateVertexBuffer(cache->vbo, points + cache->uploaded, (n - cache->uploaded)*sizeof(HMM_Vec3),
+                                 cache->uploaded*sizeof(HMM_Vec3));
+            cache->uploaded = n;
+        }
+        return;
+    }
+
+    if (n > cache->capacity) {
+        if (cache->vao) {
+            rlUnloadVertexArray(cache->vao);
+            rlUnloadVertexBuffer(cache->vbo);
+        }
+        cache->capacity = MAX(n*2, 1024);
+        cache->vao = rlLoadVertexArray();
+        rlEnableVertexArray(cache->vao);
+        cache->vbo = rlLoadVertexBuffer(0, cache->capacity*sizeof(HMM_Vec3), true);
+        rlSetVertexAttribute(0, 3, RL_FLOAT, false, 0, 0);
+        rlEnableVertexAttribute(0);
+        rlDisableVertexArray();
+    }
+
+    rlUpdateVertexBuffer(cache->vbo, points, n*sizeof(HMM_Vec3), 0);
+    cache->uploaded = n;
+    cache->version = version;
+}
+
+/* Current rlgl transform, modelview and projection, in the layout rlSetUniformMatrix wants.
+   Transpose it to get a matrix for HMM_MulM4V4. */
+static HMM_Mat4 ImpCurrentMVP(void) {
+    Matrix transform = rlGetMatrixTransform();
+    Matrix modelview = rlGetMatrixModelview();
+    Matrix projection = rlGetMatrixProjection();
+    return HMM_MulM4(HMM_MulM4(PCAST(HMM_Mat4, transform), PCAST(HMM_Mat4, modelview)), PCAST(HMM_Mat4, projection));
+}
+
+/* Sets up the default shader to draw our own vertex arrays with the current rlgl transform,
+   modelview and projection */
+static void ImpBeginVertexArrayDraw(Color color, u32 texture) {
+    rlDrawRenderBatchActive();
+
+    HMM_Mat4 mvp = ImpCurrentMVP();
+
+    s32 *locs = rlGetShaderLocsDefault();
+    f32 diffuse[4] = { color.r/255.0, color.g/255.0, color.b/255.0, color.a/255.0 };
+    f32 white[4] = { 1, 1, 1, 1 };
+    rlEnableShader(rlGetShaderIdDefault());
+    rlSetUniformMatrix(locs[RL_SHADER_LOC_MATRIX_MVP], PCAST(Matrix, mvp));
+    rlSetUniform(locs[RL_SHADER_LOC_COLOR_DIFFUSE], diffuse, RL_SHADER_UNIFORM_VEC4, 1);
+    rlSetVertexAttributeDefault(locs[RL_SHADER_LOC_VERTEX_COLOR], white, RL_SHADER_ATTRIB_VEC4, 4);
+    rlActiveTextureSlot(0);
+    rlEnableTexture(texture);
+}
+
+static void ImpEndVertexArrayDraw(void) {
+    rlDisableVertexArray();
+    rlDisableTexture();
+    rlDisableShader();
+}
+
+/* Draws count points of a cached series from first as a line strip */
+void ImpDrawSeriesCached(ImpSeriesCache *cache, s32 first, s32 count, Color color) {
+    count = MIN(count, cache->uploaded - first);
+    if (!cache->vao || count < 2) {
+        return;
+    }
+    ImpBeginVertexArrayDraw(color, rlGetTextureIdDefault());
+
+    const s32 GL_LINE_STRIP = 3;
+    rlEnableVertexArray(cache->vao);
+    glDrawArrays(GL_LINE_STRIP, first, count);
+
+    ImpEndVertexArrayDraw();
+}
+
+/* NOTE: a series drawn as one triangle strip with shared joins, instead of a quad per
+   segment. Rebuilt every frame since the facing direction follows the camera. */
+typedef struct ImpStripBuffer {
+    u32 vao;
+    u32 vbo;
+    s32 capacity;
+} ImpStripBuffer;
+
+void ImpDrawPolyline(ImpPlot *plot, ImpStripBuffer *strip, HMM_Vec3 *points, s32 n, Color color, float thickness) {
+    f32 size = plot->line_size_f*thickness;
+
+    if (plot->plotting) {
+        size *= plot->zoom;
+    }
+
+    static HMM_Vec3 *verts;
+    static f32 *interleaved;
+    static s32 scratch;
+    if (4*n > scratch) {
+        scratch = 4*n;
+        verts = realloc(verts, scratch*sizeof(HMM_Vec3));
+        interleaved = realloc(interleaved, scratch*5*sizeof(f32));
+    }
+
+    s32 count = tessellate_polyline(points, n, plot->billboard_z, size, verts);
+    if (count < 4) {
+        return;
+    }
+
+    /* Same line texture as ImpDrawLine, across the strip and constant along it */
+    Rectangle r = atlas_rect[IMP_LINE_TEXTURE];
+    f32 u = (r.x + r.width/2)/ATLAS_WIDTH;
+    f32 v[2] = { r.y/ATLAS_HEIGHT, (r.y + r.height)/ATLAS_HEIGHT };
+    for (s32 i = 0; i < count; i++) {
+        f32 *out = interleaved + i*5;
+        out[0] = verts[i].X;
+        out[1] = verts[i].Y;
+        out[2] = verts[i].Z;
+        out[3] = u;
+        out[4] = v[i & 1];
+    }
+
+    if (count > strip->capacity) {
+        if (strip->vao) {
+            rlUnloadVertexArray(strip->vao);
+            rlUnloadVertexBuffer(strip->vbo);
+        }
+        strip->capacity = MAX(count*2, 1024);
+        strip->vao = rlLoadVertexArray();
+        rlEnableVertexArray(strip->vao);
+        strip->vbo = rlLoadVertexBuffer(0, strip->capacity*5*sizeof(f32), true);
+        rlSetVertexAttribute(0, 3, RL_FLOAT, false, 5*sizeof(f32), (void *)0);
+        rlEnableVertexAttribute(0);
+        rlSetVertexAttribute(1, 2, RL_FLOAT, false, 5*sizeof(f32), (void *)(3*sizeof(f32)));
+        rlEnableVertexAttribute(1);
+        rlDisableVertexArray();
+    }
+    rlUpdateVertexBuffer(strip->vbo, interleaved, count*5*sizeof(f32), 0);
+
+    ImpBeginVertexArrayDraw(color, atlas.id);
+
+    const s32 GL_TRIANGLE_STRIP = 5;
+    rlEnableVertexArray(strip->vao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, count);
+
+    ImpEndVertexArrayDraw();
+}
+
+/* NOTE: series are split into chunks of IMP_CHUNK_SIZE segments with a bounding box each,
+   so whole chunks can be culled against the plot box and camera frustum before drawing.
+   Chunk k covers points k*IMP_CHUNK_SIZE up to and including the first point of chunk k+1. */
+#define IMP_CHUNK_SIZE 256
+
+typedef struct ImpSeriesChunks {
+    s32 n;
+    s32 count;
+    s32 capacity;
+    HMM_Vec3 *min;
+    HMM_Vec3 *max;
+    u8 *visible;
+    s32 drawn;
+    s32 culled;
+} ImpSeriesChunks;
+
+/* Recomputes the boxes of chunks from first_chunk on, the ones before are kept */
+static void ImpUpdateChunks(ImpSeriesChunks *chunks, HMM_Vec3 *points, s32 n, s32 first_chunk) {
+    chunks->n = n;
+    chunks->count = (n > 1)? (n - 2)/IMP_CHUNK_SIZE + 1 : 0;
+    if (chunks->count > chunks->capacity) {
+        chunks->capacity = chunks->count*2;
+        chunks->min = realloc(chunks->min, chunks->capacity*sizeof(HMM_Vec3));
+        chunks->max = realloc(chunks->max, chunks->capacity*sizeof(HMM_Vec3));
+        chunks->visible = realloc(chunks->visible, chunks->capacity);
+    }
+
+    for (s32 k = first_chunk; k < chunks->count; k++) {
+        s32 first = k*IMP_CHUNK_SIZE;
+        s32 last = MIN(first + IMP_CHUNK_SIZE, n - 1);
+        HMM_Vec3 min = points[first];
+        HMM_Vec3 max = points[first];
+        for (s32 i = first + 1; i <= last; i++) {
+            min.X = MIN(min.X, points[i].X); max.X = MAX(max.X, points[i].X);
+            min.Y = MIN(min.Y, points[i].Y); max.Y = MAX(max.Y, points[i].Y);
+            min.Z = MIN(min.Z, points[i].Z); max.Z = MAX(max.Z, points[i].Z);
+        }
+        chunks->min[k] = min;
+        chunks->max[k] = max;
+    }
+}
+
+void ImpBuildChunks(ImpSeriesChunks *chunks, HMM_Vec3 *points, s32 n) {
+    ImpUpdateChunks(chunks, points, n, 0);
+}
+
+/* For series that only grow: points before chunks->n are assumed unchanged, so only the last
+   partial chunk and the new ones are recomputed. Returns the first chunk that changed. */
+s32 ImpAppendChunks(ImpSeriesChunks *chunks, HMM_Vec3 *points, s32 n) {
+    s32 first_chunk = (chunks->n > 1 && n >= chunks->n)? (chunks->n - 2)/IMP_CHUNK_SIZE : 0;
+    ImpUpdateChunks(chunks, points, n, first_chunk);
+    return first_chunk;
+}
+
+/* View box in data space, the inverse of the plotting transform */
+void ImpDataViewBox(ImpPlot *plot, HMM_Vec3 *min, HMM_Vec3 *max) {
+    HMM_Vec3 mid = HMM_LerpV3(plot->plot_min, 0.5, plot->plot_max);
+    HMM_Vec3 extent = HMM_MulV3(plot->view_radius, plot->plot_scale);
+    *min = HMM_SubV3(mid, extent);
+    *max = HMM_AddV3(mid, extent);
+}
+
+/* Box is outside the plane if its corner furthest along the normal is behind it */
+static b32 ImpBoxOutsidePlane(HMM_Vec4 plane, HMM_Vec3 min, HMM_Vec3 max) {
+    HMM_Vec3 p = HMM_V3((plane.X >= 0)? max.X : min.X,
+                        (plane.Y >= 0)? max.Y : min.Y,
+                        (plane.Z >= 0)? max.Z : min.Z);
+    return plane.X*p.X + plane.Y*p.Y + plane.Z*p.Z + plane.W < 0;
+}
+
+/* Marks the chunks that overlap the plot box and the frustum. Call with the plot's data
+   transform pushed, since the frustum comes from the current rlgl matrices. */
+void ImpCullChunks(ImpPlot *plot, ImpSeriesChunks *chunks) {
+    /* Clip space planes (Gribb/Hartmann), as rows of the column vector clip matrix */
+    HMM_Mat4 clip = HMM_TransposeM4(ImpCurrentMVP());
+    HMM_Vec4 row[4];
+    for (s32 i = 0; i < 4; i++) {
+        row[i] = HMM_V4(clip.Elements[0][i], clip.Elements[1][i], clip.Elements[2][i], clip.Elements[3][i]);
+    }
+    HMM_Vec4 planes[6] = {
+        HMM_AddV4(row[3], row[0]), HMM_SubV4(row[3], row[0]),
+        HMM_AddV4(row[3], row[1]), HMM_SubV4(row[3], row[1]),
+        HMM_AddV4(row[3], row[2]), HMM_SubV4(row[3], row[2]),
+    };
+
+    HMM_Vec3 box_min, box_max;
+    ImpDataViewBox(plot, &box_min, &box_max);
+
+    chunks->drawn = 0;
+    chunks->culled = 0;
+    for (s32 k = 0; k < chunks->count; k++) {
+        HMM_Vec3 min = chunks->min[k];
+        HMM_Vec3 max = chunks->max[k];
+        b32 visible = !(max.X < box_min.X || min.X > box_max.X ||
+                        max.Y < box_min.Y || min.Y > box_max.Y ||
+                        max.Z < box_min.Z || min.Z > box_max.Z);
+        for (s32 i = 0; visible && i < 6; i++) {
+            visible = !ImpBoxOutsidePlane(planes[i], min, max);
+        }
+        chunks->visible[k] = visible;
+        if (visible) {
+            chunks->drawn++;
+        } else {
+            chunks->culled++;
+        }
+    }
+}
+
+/* Iterates runs of consecutive visible chunks as point ranges. Start with *chunk = 0. */
+b32 ImpNextChunkRun(ImpSeriesChunks *chunks, s32 *chunk, s32 *first, s32 *count) {
+    s32 k = *chunk;
+    while (k < chunks->count && !chunks->visible[k]) {
+        k++;
+    }
+    if (k >= chunks->count) {
+        *chunk = k;
+        return 0;
+    }
+    s32 end = k;
+    while (end < chunks->count && chunks->visible[end]) {
+        end++;
+    }
+    *first = k*IMP_CHUNK_SIZE;
+    *count = MIN(end*IMP_CHUNK_SIZE, chunks->n - 1) - *first + 1;
+    *chunk = end;
+    return 1;
+}
+
+/* NOTE: picking walks a BVH over the series chunks. Chunks are already spatially coherent
+   since they follow the curve, so the tree is implicit: a complete binary tree over the chunk
+   boxes in series order with node k's children at 2k and 2k+1 and chunk c at leaves + c.
+   There is no topology to build, so appending only copies the changed chunk boxes and refits
+   their ancestors, and growing past a power of two re-links the leaves under a bigger root. */
+typedef struct ImpSeriesBVH {
+    s32 leaves;
+    s32 count;
+    HMM_Vec3 *min;
+    HMM_Vec3 *max;
+} ImpSeriesBVH;
+
+/* Pick ray in data space. t is in plot units (the same along every axis), and a point at t
+   is a hit if it's within radius + spread*t of the ray, which is the pick radius in pixels. */
+typedef struct ImpRay {
+    HMM_Vec3 origin;
+    HMM_Vec3 dir;
+    HMM_Vec3 mid;
+    HMM_Vec3 scale;
+    f32 radius;
+    f32 spread;
+    f32 t_min;
+    f32 t_max;
+} ImpRay;
+
+typedef struct ImpPick {
+    b32 hit;
+    s32 segment;   /* the hit is on the segment from points[segment] to points[segment + 1] */
+    s32 nearest;   /* closest of the two points */
+    f32 s;         /* position along the segment */
+    f32 t;         /* position along the ray */
+    HMM_Vec3 point;
+} ImpPick;
+
+/* Refits the tree after the boxes from first_chunk on changed, as returned by ImpAppendChunks */
+void ImpRefitBVH(ImpSeriesBVH *bvh, ImpSeriesChunks *chunks, s32 first_chunk) {
+    s32 old_count = bvh->count;
+    if (chunks->count > bvh->leaves) {
+        s32 leaves = 1;
+        while (leaves < chunks->count) {
+            leaves *= 2;
+        }
+        bvh->leaves = leaves;
+        bvh->min = realloc(bvh->min, 2*leaves*sizeof(HMM_Vec3));
+        bvh->max = realloc(bvh->max, 2*leaves*sizeof(HMM_Vec3));
+        first_chunk = 0;
+        old_count = leaves;
+    }
+    if (bvh->leaves == 0) {
+        return;
+    }
+
+    /* Empty leaves have inverted boxes, which drop out of the unions and fail the ray test */
+    s32 end = MAX(chunks->count, old_count);
+    first_chunk = MIN(first_chunk, chunks->count);
+    for (s32 c = first_chunk; c < end; c++) {
+        if (c < chunks->count) {
+            bvh->min[bvh->leaves + c] = chunks->min[c];
+            bvh->max[bvh->leaves + c] = chunks->max[c];
+        } else {
+            bvh->min[bvh->leaves + c] = HMM_V3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+            bvh->max[bvh->leaves + c] = HMM_V3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        }
+    }
+    bvh->count = chunks->count;
+
+    s32 lo = (bvh->leaves + first_chunk)/2;
+    s32 hi = (bvh->leaves + MAX(end, 1) - 1)/2;
+    for (; hi >= 1; lo /= 2, hi /= 2) {
+        for (s32 k = lo; k <= hi; k++) {
+            HMM_Vec3 a = bvh->min[2*k], b = bvh->min[2*k + 1];
+            HMM_Vec3 c = bvh->max[2*k], d = bvh->max[2*k + 1];
+            bvh->min[k] = HMM_V3(MIN(a.X, b.X), MIN(a.Y, b.Y), MIN(a.Z, b.Z));
+            bvh->max[k] = HMM_V3(MAX(c.X, d.X), MAX(c.Y, d.Y), MAX(c.Z, d.Z));
+        }
+    }
+}
+
+/* Ray under the mouse, from the inverse of the camera and the plot's data transform. Only the
+   part inside the plot box is kept, since everything outside is clipped when drawing. */
+ImpRay ImpMouseRay(ImpPlot *plot, HMM_Mat4 modelview_inv, HMM_Vec2 mouse, HMM_Vec2 size, f32 radius_px) {
+    /* projection is handed to rlgl as is, which reads it transposed */
+    HMM_Mat4 unproject = HMM_MulM4(modelview_inv, HMM_InvGeneralM4(HMM_TransposeM4(plot->projection)));
+    HMM_Vec3 near_point[2], far_point[2];
+    for (s32 i = 0; i < 2; i++) {
+        f32 x = 2*(mouse.X + i*radius_px)/size.X - 1;
+        f32 y = 1 - 2*mouse.Y/size.Y;
+        HMM_Vec4 a = HMM_MulM4V4(unproject, HMM_V4(x, y, -1, 1));
+        HMM_Vec4 b = HMM_MulM4V4(unproject, HMM_V4(x, y, +1, 1));
+        near_point[i] = HMM_DivV3F(a.XYZ, a.W);
+        far_point[i] = HMM_DivV3F(b.XYZ, b.W);
+    }
+    HMM_Vec3 dir = HMM_NormV3(HMM_SubV3(far_point[0], near_point[0]));
+    HMM_Vec3 dir_px = HMM_NormV3(HMM_SubV3(far_point[1], near_point[1]));
+
+    ImpRay ray = {
+        .mid = HMM_LerpV3(plot->plot_min, 0.5, plot->plot_max),
+        .scale = plot->plot_scale,
+        .radius = HMM_LenV3(HMM_SubV3(near_point[1], near_point[0])),
+        .spread = HMM_LenV3(HMM_SubV3(dir_px, dir)),
+    };
+    ray.origin = HMM_AddV3(HMM_MulV3(near_point[0], ray.scale), ray.mid);
+    ray.dir = HMM_MulV3(dir, ray.scale);
+
+    HMM_Vec3 box_min, box_max;
+    ImpDataViewBox(plot, &box_min, &box_max);
+    ray.t_min = 0;
+    ray.t_max = HMM_LenV3(HMM_SubV3(far_point[0], near_point[0]));
+    for (s32 i = 0; i < 3; i++) {
+        f32 inv = 1/((ray.dir.Elements[i] != 0)? ray.dir.Elements[i] : 1e-30f);
+        f32 t0 = (box_min.Elements[i] - ray.origin.Elements[i])*inv;
+        f32 t1 = (box_max.Elements[i] - ray.origin.Elements[i])*inv;
+        ray.t_min = MAX(ray.t_min, MIN(t0, t1));
+        ray.t_max = MIN(ray.t_max, MAX(t0, t1));
+    }
+    return ray;
+}
+
+/* Entry point of the ray into a box grown by pad, or FLT_MAX if it misses within [t_min, t_max] */
+static f32 ImpRayBox(HMM_Vec3 origin, HMM_Vec3 inv_dir, HMM_Vec3 min, HMM_Vec3 max, HMM_Vec3 pad, f32 t_min, f32 t_max) {
+    if (min.X > max.X) {
+        return FLT_MAX;
+    }
+    for (s32 i = 0; i < 3; i++) {
+        f32 t0 = (min.Elements[i] - pad.Elements[i] - origin.Elements[i])*inv_dir.Elements[i];
+        f32 t1 = (max.Elements[i] + pad.Elements[i] - origin.Elements[i])*inv_dir.Elements[i];
+        t_min = MAX(t_min, MIN(t0, t1));
+        t_max = MIN(t_max, MAX(t0, t1));
+    }
+    return (t_min <= t_max)? t_min : FLT_MAX;
+}
+
+/* Nearest point along the ray of a series that's within the pick radius. Children are visited
+   near first, and anything that starts behind the best hit so far is skipped. */
+ImpPick ImpPickSeries(ImpSeriesBVH *bvh, HMM_Vec3 *points, s32 n, ImpRay ray) {
+    ImpPick pick = { .segment = -1, .nearest = -1, .t = ray.t_max };
+    if (bvh->count == 0 || ray.t_min > ray.t_max) {
+        return pick;
+    }
+
+    /* Boxes are in data space, so the pick radius at the far end of the ray is scaled back */
+    HMM_Vec3 pad = HMM_MulV3F(ray.scale, ray.radius + ray.spread*ray.t_max);
+    HMM_Vec3 inv_dir;
+    for (s32 i = 0; i < 3; i++) {
+        inv_dir.Elements[i] = 1/((ray.dir.Elements[i] != 0)? ray.dir.Elements[i] : 1e-30f);
+    }
+    HMM_Vec3 inv_scale = HMM_V3(1/ray.scale.X, 1/ray.scale.Y, 1/ray.scale.Z);
+    HMM_Vec3 origin = HMM_MulV3(HMM_SubV3(ray.origin, ray.mid), inv_scale);
+    HMM_Vec3 dir = HMM_MulV3(ray.dir, inv_scale);
+
+    s32 stack[64];
+    f32 stack_t[64];
+    s32 top = 0;
+    stack[top] = 1;
+    stack_t[top++] = ImpRayBox(ray.origin, inv_dir, bvh->min[1], bvh->max[1], pad, ray.t_min, ray.t_max);
+    while (top > 0) {
+        s32 k = stack[--top];
+        if (stack_t[top] > pick.t) {
+            continue;
+        }
+
+        if (k < bvh->leaves) {
+            f32 t0 = ImpRayBox(ray.origin, inv_dir, bvh->min[2*k], bvh->max[2*k], pad, ray.t_min, pick.t);
+            f32 t1 = ImpRayBox(ray.origin, inv_dir, bvh->min[2*k + 1], bvh->max[2*k + 1], pad, ray.t_min, pick.t);
+            s32 nearer = (t1 < t0);
+            if (MAX(t0, t1) < FLT_MAX) {
+                stack[top] = 2*k + !nearer;
+                stack_t[top++] = MAX(t0, t1);
+            }
+            if (MIN(t0, t1) < FLT_MAX) {
+                stack[top] = 2*k + nearer;
+                stack_t[top++] = MIN(t0, t1);
+            }
+            continue;
+        }
+
+        /* Closest approach of the ray to each segment, measured in plot units */
+        s32 first = (k - bvh->leaves)*IMP_CHUNK_SIZE;
+        s32 last = MIN(first + IMP_CHUNK_SIZE, n - 1);
+        HMM_Vec3 a = HMM_MulV3(HMM_SubV3(points[first], ray.mid), inv_scale);
+        for (s32 i = first; i < last; i++) {
+            HMM_Vec3 b = HMM_MulV3(HMM_SubV3(points[i + 1], ray.mid), inv_scale);
+            HMM_Vec3 u = HMM_SubV3(b, a);
+            HMM_Vec3 w = HMM_SubV3(a, origin);
+            f32 du = HMM_DotV3(dir, u);
+            f32 dw = HMM_DotV3(dir, w);
+            f32 uu = HMM_DotV3(u, u);
+            f32 denom = uu - du*du;
+            f32 s = (denom > 1e-12f*uu)? (du*dw - HMM_DotV3(u, w))/denom : 0;
+            s = CLAMP(s, 0, 1);
+            HMM_Vec3 p = HMM_AddV3(a, HMM_MulV3F(u, s));
+            f32 t = HMM_DotV3(dir, HMM_SubV3(p, origin));
+            if (t >= ray.t_min && t < pick.t) {
+                HMM_Vec3 off = HMM_SubV3(p, HMM_AddV3(origin, HMM_MulV3F(dir, t)));
+                f32 r = ray.radius + ray.spread*t;
+                if (HMM_DotV3(off, off) <= r*r) {
+                    pick.hit = 1;
+                    pick.segment = i;
+                    pick.nearest = (s < 0.5)? i : i + 1;
+                    pick.s = s;
+                    pick.t = t;
+                }
+            }
+            a = b;
+        }
+    }
+
+    if (pick.hit) {
+        pick.point = HMM_LerpV3(points[pick.segment], pick.s, points[pick.segment + 1]);
+    }
+    return pick;
+}
+
+/* NOTE: back to front ordering for translucent markers and lines. Depths come from one
+   batched pass over the points with the current matrices, are quantized to 16 bits, and
+   ordered with a two pass LSD radix sort. When the camera has only moved a little, last
+   frame's order is almost right, so it's insertion sorted instead, falling back to the radix
+   sort if that turns out to be too much work. */
+#define IMP_DEPTH_INCREMENTAL_DELTA 0.02
+#define IMP_DEPTH_INCREMENTAL_WORK 2
+
+typedef struct ImpDepthSort {
+    s32 n;
+    s32 capacity;
+    u32 *order;
+    u32 *scratch;
+    u16 *keys;
+    u16 *scratch_keys;
+    HMM_Mat4 last_mvp;
+    b32 incremental;
+} ImpDepthSort;
+
+/* Sorts order by keys[order[i]]. The keys are gathered once and carried along with the
+   indices, so both passes read sequentially. scratch_keys needs room for 2*n. */
+static void ImpRadixSort16(const u16 *keys, u32 *order, u32 *scratch, u16 *scratch_keys, s32 n) {
+    u16 *kin = scratch_keys, *kout = scratch_keys + n;
+    u32 *in = order, *out = scratch;
+    s32 counts[2][256] = {0};
+    for (s32 i = 0; i < n; i++) {
+        u16 k = kin[i] = keys[order[i]];
+        counts[0][k & 0xFF]++;
+        counts[1][k >> 8]++;
+    }
+    for (s32 pass = 0; pass < 2; pass++) {
+        s32 offsets[256];
+        for (s32 d = 0, sum = 0; d < 256; d++) {
+            offsets[d] = sum;
+            sum += counts[pass][d];
+        }
+        s32 shift = pass*8;
+        for (s32 i = 0; i < n; i++) {
+            s32 o = offsets[(kin[i] >> shift) & 0xFF]++;
+            out[o] = in[i];
+            kout[o] = kin[i];
+        }
+        u32 *t = in; in = out; out = t;
+        u16 *tk = kin; kin = kout; kout = tk;
+    }
+    /* Two passes, so the result is back in the caller's order array */
+}
+
+/* Returns 0 if it gave up after limit moves, order is still a permutation then */
+static b32 ImpInsertionSort16(const u16 *keys, u32 *order, s32 n, s64 limit) {
+    s64 moves = 0;
+    for (s32 i = 1; i < n; i++) {
+        u32 v = order[i];
+        u16 k = keys[v];
+        s32 j = i;
+        while (j > 0 && keys[order[j-1]] > k) {
+            order[j] = order[j-1];
+            j--;
+            if (++moves > limit) {
+                order[j] = v;
+                return 0;
+            }
+        }
+        order[j] = v;
+    }
+    return 1;
+}
+
+/* Orders points back to front with the current rlgl matrices, call with the plot's data
+   transform pushed. Draw points[sort->order[i]] for i from 0 to n. */
+void ImpSortByDepth(ImpDepthSort *sort, HMM_Vec3 *points, s32 n) {
+    if (n > sort->capacity) {
+        sort->capacity = n;
+        sort->order = realloc(sort->order, n*sizeof(u32));
+        sort->scratch = realloc(sort->scratch, n*sizeof(u32));
+        sort->keys = realloc(sort->keys, n*sizeof(u16));
+        sort->scratch_keys = realloc(sort->scratch_keys, 2*n*sizeof(u16));
+        sort->n = 0;
+    }
+
+    HMM_Mat4 mvp = ImpCurrentMVP();
+    f32 delta = 0, scale = 0;
+    for (s32 i = 0; i < 16; i++) {
+        delta += fabs(mvp.Elements[i/4][i%4] - sort->last_mvp.Elements[i/4][i%4]);
+        scale += fabs(sort->last_mvp.Elements[i/4][i%4]);
+    }
+    sort->incremental = (sort->n == n) && (delta < IMP_DEPTH_INCREMENTAL_DELTA*scale);
+    sort->last_mvp = mvp;
+
+    /* Batched depth, reusing scratch as floats since it's free until the radix sort */
+    HMM_Mat4 clip = HMM_TransposeM4(mvp);
+    HMM_Vec4 r2 = HMM_V4(clip.Elements[0][2], clip.Elements[1][2], clip.Elements[2][2], clip.Elements[3][2]);
+    HMM_Vec4 r3 = HMM_V4(clip.Elements[0][3], clip.Elements[1][3], clip.Elements[2][3], clip.Elements[3][3]);
+    f32 *depth = (f32 *)sort->scratch;
+    f32 dmin = 1e30, dmax = -1e30;
+    for (s32 i = 0; i < n; i++) {
+        HMM_Vec3 p = points[i];
+        f32 z = r2.X*p.X + r2.Y*p.Y + r2.Z*p.Z + r2.W;
+        f32 w = r3.X*p.X + r3.Y*p.Y + r3.Z*p.Z + r3.W;
+        /* Behind the camera, never visible so just draw it first */
+        depth[i] = (w > 1e-6)? z/w : 1e30;
+        if (depth[i] < 1e30) {
+            dmin = MIN(dmin, depth[i]);
+            dmax = MAX(dmax, depth[i]);
+        }
+    }
+    f32 q = (dmax > dmin)? 65535.0/(dmax - dmin) : 0;
+    for (s32 i = 0; i < n; i++) {
+        /* Far first, so larger depth gets the smaller key */
+        sort->keys[i] = (depth[i] < 1e30)? 65535 - (u16)((depth[i] - dmin)*q) : 0;
+    }
+
+    if (!sort->incremental) {
+        for (s32 i = 0; i < n; i++) sort->order[i] = i;
+    }
+    if (!sort->incremental ||
+        !ImpInsertionSort16(sort->keys, sort->order, n, (s64)IMP_DEPTH_INCREMENTAL_WORK*n)) {
+        ImpRadixSort16(sort->keys, sort->order, sort->scratch, sort->scratch_keys, n);
+        sort->incremental = 0;
+    }
+    sort->n = n;
+}
+
+/* Translucent markers, sorted back to front */
+void ImpDrawMarkersSorted(ImpDepthSort *sort, ImpDrawPlane plane, HMM_Vec3 *points, s32 n, s32 marker, Color color) {
+    ImpSortByDepth(sort, points, n);
+    Rectangle rect = atlas_rect[marker];
+    HMM_Vec3 half = HMM_MulV3F(HMM_AddV3(plane.r, plane.u), 0.5);
+    rlDrawRenderBatchActive();
+    rlDisableDepthMask();
+    for (s32 i = 0; i < n; i++) {
+        ImpDrawPlane p = plane;
+        p.bl = HMM_SubV3(points[sort->order[i]], half);
+        ImpDrawTexQuadFromAtlas(p, rect, color);
+    }
+    rlDrawRenderBatchActive();
+    rlEnableDepthMask();
+}
+
+/* Translucent lines, drawn as separate segments sorted back to front by their midpoints.
+   points holds runs polylines, run r ending before run_ends[r], and all their segments are
+   sorted together. */
+void ImpDrawLinesSorted(ImpPlot *plot, ImpDepthSort *sort, HMM_Vec3 *points, const s32 *run_ends, s32 runs,
+                        Color color, float thickness) {
+    static HMM_Vec3 *mid;
+    static u32 *start;
+    static s32 capacity;
+    s32 n = (runs > 0)? run_ends[runs - 1] : 0;
+    if (n > capacity) {
+        capacity = n;
+        mid = realloc(mid, capacity*sizeof(HMM_Vec3));
+        start = realloc(start, capacity*sizeof(u32));
+    }
+    s32 segments = 0;
+    for (s32 r = 0, first = 0; r < runs; first = run_ends[r++]) {
+        for (s32 i = first; i < run_ends[r] - 1; i++) {
+            mid[segments] = HMM_LerpV3(points[i], 0.5, points[i+1]);
+            start[segments++] = i;
+        }
+    }
+    ImpSortByDepth(sort, mid, segments);
+    rlDrawRenderBatchActive();
+    rlDisableDepthMask();
+    for (s32 i = 0; i < segments; i++) {
+        u32 k = start[sort->order[i]];
+        ImpDrawLine(plot, points[k], points[k+1], color, thickness);
+    }
+    rlDrawRenderBatchActive();
+    rlEnableDepthMask();
+}
+
+/* Clips a data space polyline to the view box before tessellating it, so zoomed in curves
+   don't spill out of the plot cube. Translucent lines are depth sorted with sort, which should
+   be kept with this polyline between frames. */
+void ImpDrawPolylineClipped(ImpPlot *plot, ImpStripBuffer *strip, ImpDepthSort *sort, HMM_Vec3 *points, s32 n,
+                            Color color, float thickness) {
+    static HMM_Vec3 *clipped;
+    static s32 *run_ends;
+    static s32 scratch;
+    if (n > scratch) {
+        scratch = n;
+        clipped = realloc(clipped, 2*scratch*sizeof(HMM_Vec3));
+        run_ends = realloc(run_ends, scratch*sizeof(s32));
+    }
+
+    HMM_Vec3 min, max;
+    ImpDataViewBox(plot, &min, &max);
+    s32 runs;
+    clip_polyline(&points->X, &points->Y, &points->Z, 3, n, min, max, clipped, run_ends, &runs);
+
+    if (color.a < 255) {
+        /* A strip overlapping itself would blend in whatever order it was tessellated */
+        ImpDrawLinesSorted(plot, sort, clipped, run_ends, runs, color, thickness);
+        return;
+    }
+    for (s32 r = 0, first = 0; r < runs; first = run_ends[r++]) {
+        ImpDrawPolyline(plot, strip, clipped + first, run_ends[r] - first, color, thickness);
+    }
+}
+
+/* NOTE: point clouds too big to draw every frame are kept in an octree with additive lod.
+   Every node keeps a spread out subsample of its points and passes the rest on to its
+   children, so drawing a node and then its children only ever adds detail. Points are
+   reordered so each node's points are contiguous, and all of them live in one vertex
+   buffer. Each frame nodes are picked biggest on screen first until the point budget is
+   used up, and the budget grows while the camera holds still. */
+#define IMP_OCTREE_NODE_POINTS 4096
+#define IMP_OCTREE_MAX_DEPTH 20
+#define IMP_OCTREE_MOVING_BUDGET (1 << 20)
+#define IMP_OCTREE_MAX_BUDGET (1 << 24)
+
+typedef struct ImpOctreeNode {
+    HMM_Vec3 min;
+    HMM_Vec3 max;
+    s32 first;
+    s32 count;
+    s32 children[8];
+} ImpOctreeNode;
+
+typedef struct ImpOctree {
+    HMM_Vec3 *points;
+    s32 n;
+    ImpOctreeNode *nodes;
+    s32 node_count;
+
+    u32 vao;
+    u32 vbo;
+
+    s32 *selected;
+    s32 selected_count;
+    s32 selected_points;
+    s32 budget;
+    HMM_Mat4 last_mvp;
+} ImpOctree;
+
+typedef struct ImpOctreeTask {
+    HMM_Vec3 *points;
+    s32 first;
+    s32 count;
+    HMM_Vec3 min;
+    HMM_Vec3 max;
+    ImpOctreeNode *nodes;
+    s32 node_count;
+    s32 node_capacity;
+} ImpOctreeTask;
+
+static inline s32 ImpOctant(HMM_Vec3 p, HMM_Vec3 c) {
+    return (p.X >= c.X) | (p.Y >= c.Y) << 1 | (p.Z >= c.Z) << 2;
+}
+
+static void ImpOctantBounds(HMM_Vec3 min, HMM_Vec3 max, s32 o, HMM_Vec3 *out_min, HMM_Vec3 *out_max) {
+    HMM_Vec3 c = HMM_LerpV3(min, 0.5, max);
+    *out_min = HMM_V3((o & 1)? c.X : min.X, (o & 2)? c.Y : min.Y, (o & 4)? c.Z : min.Z);
+    *out_max = HMM_V3((o & 1)? max.X : c.X, (o & 2)? max.Y : c.Y, (o & 4)? max.Z : c.Z);
+}
+
+/* Moves a spread out subsample of keep points to the front of p */
+static void ImpOctreeSubsample(HMM_Vec3 *p, s32 count, s32 keep) {
+    for (s32 j = 0; j < keep; j++) {
+        s32 k = (s64)j*count/keep;
+        HMM_Vec3 t = p[j]; p[j] = p[k]; p[k] = t;
+    }
+}
+
+/* In place 8 way partition by octant around c, like an american flag sort pass */
+static void ImpOctreePartition(HMM_Vec3 *p, s32 count, HMM_Vec3 c, s32 first[8], s32 counts[8]) {
+    s32 next[8], end[8];
+    for (s32 o = 0; o < 8; o++) counts[o] = 0;
+    for (s32 i = 0; i < count; i++) counts[ImpOctant(p[i], c)]++;
+    for (s32 o = 0, sum = 0; o < 8; o++) {
+        first[o] = next[o] = sum;
+        sum += counts[o];
+        end[o] = sum;
+    }
+    for (s32 b = 0; b < 8; b++) {
+        while (next[b] < end[b]) {
+            s32 o = ImpOctant(p[next[b]], c);
+            if (o == b) {
+                next[b]++;
+            } else {
+                HMM_Vec3 t = p[next[b]]; p[next[b]] = p[next[o]]; p[next[o]++] = t;
+            }
+        }
+    }
+}
+
+static s32 ImpOctreeBuildNode(ImpOctreeTask *task, s32 first, s32 count, HMM_Vec3 min, HMM_Vec3 max, s32 depth) {
+    if (task->node_count == task->node_capacity) {
+        task->node_capacity = MAX(2*task->node_capacity, 64);
+        task->nodes = realloc(task->nodes, task->node_capacity*sizeof(ImpOctreeNode));
+    }
+    s32 index = task->node_count++;
+
+    s32 keep = count;
+    if (count > IMP_OCTREE_NODE_POINTS && depth < IMP_OCTREE_MAX_DEPTH) {
+        keep = IMP_OCTREE_NODE_POINTS;
+        ImpOctreeSubsample(task->points + first, count, keep);
+    }
+
+    ImpOctreeNode *node = task->nodes + index;
+    *node = (ImpOctreeNode){ .min = min, .max = max, .first = first, .count = keep };
+    for (s32 o = 0; o < 8; o++) node->children[o] = -1;
+    if (keep == count) {
+        return index;
+    }
+
+    s32 child_first[8], child_count[8];
+    ImpOctreePartition(task->points + first + keep, count - keep, HMM_LerpV3(min, 0.5, max), child_first, child_count);
+    for (s32 o = 0; o < 8; o++) {
+        if (child_count[o]) {
+            HMM_Vec3 cmin, cmax;
+            ImpOctantBounds(min, max, o, &cmin, &cmax);
+            s32 child = ImpOctreeBuildNode(task, first + keep + child_first[o], child_count[o], cmin, cmax, depth + 1);
+            /* nodes may have moved */
+            task->nodes[index].children[o] = child;
+        }
+    }
+    return index;
+}
+
+#ifdef _WIN32
+static unsigned long __stdcall ImpOctreeThreadProc(void *arg) {
+#else
+static void *ImpOctreeThreadProc(void *arg) {
+#endif
+    ImpOctreeTask *task = arg;
+    ImpOctreeBuildNode(task, task->first, task->count, task->min, task->max, 1);
+    return 0;
+}
+
+/* Builds the octree over a copy of points, each octant of the root on its own thread */
+void ImpBuildOctree(ImpOctree *tree, HMM_Vec3 *points, s32 n) {
+    *tree = (ImpOctree){0};
+    if (n <= 0) {
+        return;
+    }
+    tree->n = n;
+    tree->points = malloc(n*sizeof(HMM_Vec3));
+    memcpy(tree->points, points, n*sizeof(HMM_Vec3));
+
+    /* Cube bounds so nodes stay cubes */
+    HMM_Vec3 min = points[0], max = points[0];
+    for (s32 i = 1; i < n; i++) {
+        min.X = MIN(min.X, points[i].X); max.X = MAX(max.X, points[i].X);
+        min.Y = MIN(min.Y, points[i].Y); max.Y = MAX(max.Y, points[i].Y);
+        min.Z = MIN(min.Z, points[i].Z); max.Z = MAX(max.Z, points[i].Z);
+    }
+    HMM_Vec3 size = HMM_SubV3(max, min);
+    f32 side = MAX(size.X, MAX(size.Y, size.Z))*1.0001 + 1e-6;
+    max = HMM_AddV3(min, HMM_V3(side, side, side));
+
+    s32 keep = MIN(n, IMP_OCTREE_NODE_POINTS);
+    ImpOctreeSubsample(tree->points, n, keep);
+    s32 child_first[8], child_count[8];
+    ImpOctreePartition(tree->points + keep, n - keep, HMM_LerpV3(min, 0.5, max), child_first, child_count);
+
+    ImpOctreeTask tasks[8] = {0};
+    ImpThread threads[8];
+    b32 started[8] = {0};
+    for (s32 o = 0; o < 8; o++) {
+        tasks[o].points = tree->points;
+        tasks[o].first = keep + child_first[o];
+        tasks[o].count = child_count[o];
+        ImpOctantBounds(min, max, o, &tasks[o].min, &tasks[o].max);
+        if (!child_count[o]) continue;
+#ifdef _WIN32
+        threads[o] = CreateThread(0, 0, ImpOctreeThreadProc, tasks + o, 0, 0);
+        started[o] = (threads[o] != 0);
+#else
+        started[o] = (pthread_create(threads + o, 0, ImpOctreeThreadProc, tasks + o) == 0);
+#endif
+        /* NOTE: out of threads, build this octant here instead */
+        if (!started[o]) {
+            ImpOctreeThreadProc(tasks + o);
+        }
+    }
+
+    s32 total = 1;
+    for (s32 o = 0; o < 8; o++) {
+        if (started[o]) {
+#ifdef _WIN32
+            WaitForSingleObject(threads[o], 0xFFFFFFFF);
+            CloseHandle(threads[o]);
+#else
+            pthread_join(threads[o], 0);
+#endif
+        }
+        total += tasks[o].node_count;
+    }
+
+    /* Stitch the subtrees together behind the root */
+    tree->nodes = malloc(total*sizeof(ImpOctreeNode));
+    tree->selected = malloc(total*sizeof(s32));
+    ImpOctreeNode *root = tree->nodes;
+    *root = (ImpOctreeNode){ .min = min, .max = max, .first = 0, .count = keep };
+    tree->node_count = 1;
+    for (s32 o = 0; o < 8; o++) {
+        root->children[o] = -1;
+        if (!child_count[o]) continue;
+        s32 base = tree->node_count;
+        for (s32 i = 0; i < tasks[o].node_count; i++) {
+            ImpOctreeNode node = tasks[o].nodes[i];
+            for (s32 c = 0; c < 8; c++) {
+                if (node.children[c] >= 0) node.children[c] += base;
+            }
+            tree->nodes[tree->node_count++] = node;
+        }
+        root->children[o] = base;
+        free(tasks[o].nodes);
+    }
+
+    tree->vao = rlLoadVertexArray();
+    rlEnableVertexArray(tree->vao);
+    tree->vbo = rlLoadVertexBuffer(tree->points, n*sizeof(HMM_Vec3), false);
+    rlSetVertexAttribute(0, 3, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(0);
+    rlDisableVertexArray();
+    tree->budget = IMP_OCTREE_MOVING_BUDGET;
+}
+
+/* Picks nodes to draw, largest on screen first, within the point budget. Call with the plot's
+   data transform pushed. */
+void ImpSelectOctreeNodes(ImpOctree *tree, f32 screen_height) {
+    tree->selected_count = 0;
+    tree->selected_points = 0;
+    if (!tree->node_count) {
+        return;
+    }
+
+    HMM_Mat4 mvp = ImpCurrentMVP();
+    if (memcmp(&mvp, &tree->last_mvp, sizeof(mvp)) == 0) {
+        /* Camera holding still, refine */
+        tree->budget = MIN(tree->budget*2, IMP_OCTREE_MAX_BUDGET);
+    } else {
+        tree->budget = IMP_OCTREE_MOVING_BUDGET;
+    }
+    tree->last_mvp = mvp;
+
+    HMM_Mat4 clip = HMM_TransposeM4(mvp);
+    HMM_Vec4 row[4];
+    for (s32 i = 0; i < 4; i++) {
+        row[i] = HMM_V4(clip.Elements[0][i], clip.Elements[1][i], clip.Elements[2][i], clip.Elements[3][i]);
+    }
+    HMM_Vec4 planes[6] = {
+        HMM_AddV4(row[3], row[0]), HMM_SubV4(row[3], row[0]),
+        HMM_AddV4(row[3], row[1]), HMM_SubV4(row[3], row[1]),
+        HMM_AddV4(row[3], row[2]), HMM_SubV4(row[3], row[2]),
+    };
+    /* Largest stretch of a data space length into clip x or y, for projected node sizes */
+    f32 stretch = MAX(HMM_LenV3(row[0].XYZ), HMM_LenV3(row[1].XYZ));
+
+    /* Max heap on projected size */
+    static f32 *heap_size;
+    static s32 *heap_node;
+    static s32 heap_capacity;
+    if (tree->node_count > heap_capacity) {
+        heap_capacity = tree->node_count;
+        heap_size = realloc(heap_size, heap_capacity*sizeof(f32));
+        heap_node = realloc(heap_node, heap_capacity*sizeof(s32));
+    }
+    s32 heap_count = 0;
+
+#define HEAP_SWAP(a, b) do { f32 ts = heap_size[a]; heap_size[a] = heap_size[b]; heap_size[b] = ts; \
+                             s32 tn = heap_node[a]; heap_node[a] = heap_node[b]; heap_node[b] = tn; } while (0)
+    heap_size[0] = 1e30;
+    heap_node[0] = 0;
+    heap_count = 1;
+
+    while (heap_count) {
+        s32 index = heap_node[0];
+        heap_count--;
+        heap_size[0] = heap_size[heap_count];
+        heap_node[0] = heap_node[heap_count];
+        for (s32 i = 0;;) {
+            s32 l = 2*i + 1, r = 2*i + 2, m = i;
+            if (l < heap_count && heap_size[l] > heap_size[m]) m = l;
+            if (r < heap_count && heap_size[r] > heap_size[m]) m = r;
+            if (m == i) break;
+            HEAP_SWAP(i, m);
+            i = m;
+        }
+
+        ImpOctreeNode *node = tree->nodes + index;
+        if (tree->selected_points + node->count > tree->budget) {
+            continue;
+        }
+        tree->selected[tree->selected_count++] = index;
+        tree->selected_points += node->count;
+
+        for (s32 o = 0; o < 8; o++) {
+            s32 c = node->children[o];
+            if (c < 0) continue;
+            ImpOctreeNode *child = tree->nodes + c;
+            b32 visible = 1;
+            for (s32 i = 0; visible && i < 6; i++) {
+                visible = !ImpBoxOutsidePlane(planes[i], child->min, child->max);
+            }
+            if (!visible) continue;
+
+            HMM_Vec3 center = HMM_LerpV3(child->min, 0.5, child->max);
+            f32 w = HMM_DotV4(row[3], HMM_V4V(center, 1));
+            f32 radius = 0.5*HMM_LenV3(HMM_SubV3(child->max, child->min));
+            f32 size = radius*stretch/MAX(w, 1e-6)*0.5*screen_height;
+            /* Smaller than a pixel adds nothing visible */
+            if (size < 1) continue;
+
+            s32 i = heap_count++;
+            heap_size[i] = size;
+            heap_node[i] = c;
+            while (i > 0 && heap_size[(i - 1)/2] < heap_size[i]) {
+                HEAP_SWAP(i, (i - 1)/2);
+                i = (i - 1)/2;
+            }
+        }
+    }
+#undef HEAP_SWAP
+}
+
+void ImpDrawOctree(ImpOctree *tree, Color color) {
+    if (!tree->selected_count) {
+        return;
+    }
+    ImpBeginVertexArrayDraw(color, rlGetTextureIdDefault());
+
+    const s32 GL_POINTS = 0;
+    rlEnableVertexArray(tree->vao);
+    for (s32 i = 0; i < tree->selected_count; i++) {
+        ImpOctreeNode *node = tree->nodes + tree->selected[i];
+        glDrawArrays(GL_POINTS, node->first, node->count);
+    }
+
+    ImpEndVertexArrayDraw();
+}
+
+/* NOTE: surface series, z = f(x, y) sampled on a w by h grid. Only heights live in the
+   vertex buffer, x and y come from gl_VertexID, so a data change uploads 4 bytes a vertex.
+   Triangle indices only depend on the grid size and lod step, so they are shared between
+   every surface with the same (w, h, step). */
+#define IMP_SURFACE_MAX_CELLS (1 << 20)
+#define IMP_GRID_INDEX_CACHE 16
+
+typedef struct ImpGridIndices {
+    s32 w;
+    s32 h;
+    s32 step;
+    u32 ebo;
+    s32 count;
+} ImpGridIndices;
+
+static ImpGridIndices imp_grid_indices[IMP_GRID_INDEX_CACHE];
+static s32 imp_grid_indices_next;
+
+/* Triangles over every step-th row and column, plus the last ones so edges line up */
+ImpGridIndices *ImpGetGridIndices(s32 w, s32 h, s32 step) {
+    for (s32 i = 0; i < IMP_GRID_INDEX_CACHE; i++) {
+        ImpGridIndices *g = imp_grid_indices + i;
+        if (g->ebo && g->w == w && g->h == h && g->step == step) {
+            return g;
+        }
+    }
+
+    ImpGridIndices *g = imp_grid_indices + imp_grid_indices_next;
+    imp_grid_indices_next = (imp_grid_indices_next + 1) % IMP_GRID_INDEX_CACHE;
+    if (g->ebo) {
+        rlUnloadVertexBuffer(g->ebo);
+    }
+
+    s32 cols = (w - 1 + step - 1)/step + 1;
+    s32 rows = (h - 1 + step - 1)/step + 1;
+    u32 *indices = malloc((s64)(cols - 1)*(rows - 1)*6*sizeof(u32));
+    s32 count = 0;
+    for (s32 r = 0; r < rows - 1; r++) {
+        u32 j0 = MIN(r*step, h - 1), j1 = MIN((r + 1)*step, h - 1);
+        for (s32 c = 0; c < cols - 1; c++) {
+            u32 i0 = MIN(c*step, w - 1), i1 = MIN((c + 1)*step, w - 1);
+            u32 a = j0*w + i0, b = j0*w + i1, d = j1*w + i0, e = j1*w + i1;
+            indices[count++] = a; indices[count++] = b; indices[count++] = e;
+            indices[count++] = a; indices[count++] = e; indices[count++] = d;
+        }
+    }
+
+    *g = (ImpGridIndices){ .w = w, .h = h, .step = step, .count = count };
+    g->ebo = rlLoadVertexBufferElement(indices, count*sizeof(u32), false);
+    free(indices);
+    return g;
+}
+
+typedef struct ImpSurface {
+    s32 w;
+    s32 h;
+    /* x, y of sample (0, 0) and the spacing between samples */
+    f32 x0;
+    f32 y0;
+    f32 dx;
+    f32 dy;
+    f32 zmin;
+    f32 zmax;
+    u32 vao;
+    u32 vbo;
+    s32 step;
+} ImpSurface;
+
+static struct {
+    u32 id;
+    s32 height;
+    s32 mvp;
+    s32 grid;
+    s32 frame;
+    s32 zrange;
+    s32 low;
+    s32 high;
+} imp_surface_shader;
+
+static const char *imp_surface_vs =
+    "#version 330\n"
+    "in float height;\n"
+    "uniform mat4 mvp;\n"
+    "uniform ivec2 grid;\n"
+    "uniform vec4 frame;\n"
+    "uniform vec2 zrange;\n"
+    "out float t;\n"
+    "void main() {\n"
+    "    int i = gl_VertexID % grid.x;\n"
+    "    int j = gl_VertexID / grid.x;\n"
+    "    t = clamp((height - zrange.x)/max(zrange.y - zrange.x, 1e-20), 0.0, 1.0);\n"
+    "    gl_Position = mvp*vec4(frame.x + frame.z*float(i), frame.y + frame.w*float(j), height, 1.0);\n"
+    "}\n";
+
+static const char *imp_surface_fs =
+    "#version 330\n"
+    "in float t;\n"
+    "uniform vec4 low;\n"
+    "uniform vec4 high;\n"
+    "out vec4 finalColor;\n"
+    "void main() {\n"
+    "    finalColor = mix(low, high, t);\n"
+    "}\n";
+
+void ImpInitSurface(ImpSurface *surface, s32 w, s32 h, f32 x0, f32 y0, f32 dx, f32 dy) {
+    if (!imp_surface_shader.id) {
+        u32 id = rlLoadShaderCode(imp_surface_vs, imp_surface_fs);
+        imp_surface_shader.id = id;
+        imp_surface_shader.height = rlGetLocationAttrib(id, "height");
+        imp_surface_shader.mvp = rlGetLocationUniform(id, "mvp");
+        imp_surface_shader.grid = rlGetLocationUniform(id, "grid");
+        imp_surface_shader.frame = rlGetLocationUniform(id, "frame");
+        imp_surface_shader.zrange = rlGetLocationUniform(id, "zrange");
+        imp_surface_shader.low = rlGetLocationUniform(id, "low");
+        imp_surface_shader.high = rlGetLocationUniform(id, "high");
+    }
+
+    *surface = (ImpSurface){ .w = w, .h = h, .x0 = x0, .y0 = y0, .dx = dx, .dy = dy };
+    surface->vao = rlLoadVertexArray();
+    rlEnableVertexArray(surface->vao);
+    surface->vbo = rlLoadVertexBuffer(0, w*h*sizeof(f32), true);
+    rlSetVertexAttribute(imp_surface_shader.height, 1, RL_FLOAT, false, 0, 0);
+    rlEnableVertexAttribute(imp_surface_shader.height);
+    rlDisableVertexArray();
+}
+
+/* Uploads new heights, w*h of them, row by row */
+void ImpUpdateSurface(ImpSurface *surface, f32 *z) {
+    s32 n = surface->w*surface->h;
+    f32 zmin = z[0], zmax = z[0];
+    for (s32 i = 1; i < n; i++) {
+        zmin = MIN(zmin, z[i]);
+        zmax = MAX(zmax, z[i]);
+    }
+    surface->zmin = zmin;
+    surface->zmax = zmax;
+    rlUpdateVertexBuffer(surface->vbo, z, n*sizeof(f32), 0);
+}
+
+/* Draws the surface in one batch, decimated so it stays under IMP_SURFACE_MAX_CELLS and
+   about a cell per pixel. Call with the plot's data transform pushed. */
+void ImpDrawSurface(ImpSurface *surface, f32 screen_height, Color low, Color high) {
+    s32 w = surface->w, h = surface->h;
+    if (!surface->vao || w < 2 || h < 2) {
+        return;
+    }
+    rlDrawRenderBatchActive();
+    HMM_Mat4 mvp = ImpCurrentMVP();
+
+    /* Pick the lod step */
+    s32 step = 1;
+    while ((s64)(w/step)*(h/step) > IMP_SURFACE_MAX_CELLS) {
+        step *= 2;
+    }
+    HMM_Mat4 clip = HMM_TransposeM4(mvp);
+    HMM_Vec4 row0 = HMM_V4(clip.Elements[0][0], clip.Elements[1][0], clip.Elements[2][0], clip.Elements[3][0]);
+    HMM_Vec4 row1 = HMM_V4(clip.Elements[0][1], clip.Elements[1][1], clip.Elements[2][1], clip.Elements[3][1]);
+    HMM_Vec4 row3 = HMM_V4(clip.Elements[0][3], clip.Elements[1][3], clip.Elements[2][3], clip.Elements[3][3]);
+    HMM_Vec3 center = HMM_V3(surface->x0 + 0.5*surface->dx*(w - 1), surface->y0 + 0.5*surface->dy*(h - 1),
+                             0.5*(surface->zmin + surface->zmax));
+    f32 depth = HMM_DotV4(row3, HMM_V4V(center, 1));
+    f32 extent = MAX(fabs(surface->dx)*(w - 1), fabs(surface->dy)*(h - 1));
+    f32 stretch = MAX(HMM_LenV3(row0.XYZ), HMM_LenV3(row1.XYZ));
+    f32 pixels = extent*stretch/MAX(depth, 1e-6)*0.5*screen_height;
+    s32 cells = MAX(w, h) - 1;
+    while (cells/(2*step) >= pixels && 2*step < cells) {
+        step *= 2;
+    }
+    surface->step = step;
+
+    ImpGridIndices *indices = ImpGetGridIndices(w, h, step);
+
+    s32 grid[2] = { w, h };
+    f32 frame[4] = { surface->x0, surface->y0, surface->dx, surface->dy };
+    f32 zrange[2] = { surface->zmin, surface->zmax };
+    f32 lowf[4] = { low.r/255.0, low.g/255.0, low.b/255.0, low.a/255.0 };
+    f32 highf[4] = { high.r/255.0, high.g/255.0, high.b/255.0, high.a/255.0 };
+    rlEnableShader(imp_surface_shader.id);
+    rlSetUniformMatrix(imp_surface_shader.mvp, PCAST(Matrix, mvp));
+    rlSetUniform(imp_surface_shader.grid, grid, RL_SHADER_UNIFORM_IVEC2, 1);
+    rlSetUniform(imp_surface_shader.frame, frame, RL_SHADER_UNIFORM_VEC4, 1);
+    rlSetUniform(imp_surface_shader.zrange, zrange, RL_SHADER_UNIFORM_VEC2, 1);
+    rlSetUniform(imp_surface_shader.low, lowf, RL_SHADER_UNIFORM_VEC4, 1);
+    rlSetUniform(imp_surface_shader.high, highf, RL_SHADER_UNIFORM_VEC4, 1);
+
+    const s32 GL_TRIANGLES = 4;
+    const s32 GL_UNSIGNED_INT = 0x1405;
+    rlEnableVertexArray(surface->vao);
+    rlEnableVertexBufferElement(indices->ebo);
+    glDrawElements(GL_TRIANGLES, indices->count, GL_UNSIGNED_INT, 0);
+    rlDisableVertexArray();
+    rlDisableShader();
+}
+
 s32 ImpInsideViewBox(ImpPlot *plot, HMM_Vec3 p) {
     return !((fabs(p.X) > plot->view_radius.X) ||
              (fabs(p.Y) > plot->view_radius.Y) ||
              (fabs(p.Z) > plot->view_radius.Z));
 }
 
+/* Adds a set of n parallel lines to the grid cache, swept from start-end by sweep */
 void ImpDrawGridLines(ImpPlot *plot, HMM_Vec3 start, HMM_Vec3 end, HMM_Vec3 sweep, Color color, s32 n, float thickness) {
+    ImpGridCache *grid = &plot->grid;
     HMM_Vec3 step = HMM_DivV3F(sweep, n-1);
-    ImpDrawPlane p;
     HMM_Vec3 dir = HMM_SubV3(end, start);
+    /* All lines in the set are parallel, so they share one width vector */
+    HMM_Vec3 width_dir = ImpLineWidthDir(plot, dir, thickness);
+    HMM_Vec3 half_width = HMM_MulV3F(width_dir, 0.5);
+
+    if (grid->count + 6*n > grid->capacity) {
+        grid->capacity = MAX(2*grid->capacity, grid->count + 6*n);
+        grid->verts = realloc(grid->verts, grid->capacity*sizeof(ImpGridVertex));
+    }
 
     Rectangle r = atlas_rect[IMP_LINE_TEXTURE];
+    HMM_Vec2 ttl = HMM_V2(r.x/ATLAS_WIDTH, r.y/ATLAS_HEIGHT);
+    HMM_Vec2 tbr = HMM_V2((r.x + r.width)/ATLAS_WIDTH, (r.y + r.height)/ATLAS_HEIGHT);
     for (s32 i = 0; i < n; i++) {
-        if (ImpInsideViewBox(plot, start))
-            ImpDrawLine(plot, start, end, color, thickness);
+        if (ImpInsideViewBox(plot, start)) {
+            /* Same corners and texture coordinates as ImpDrawLine, as two triangles */
+            HMM_Vec3 bl = HMM_SubV3(start, half_width);
+            HMM_Vec3 br = HMM_AddV3(bl, dir);
+            HMM_Vec3 tl = HMM_AddV3(bl, width_dir);
+            HMM_Vec3 tr = HMM_AddV3(tl, dir);
+            ImpGridVertex *v = grid->verts + grid->count;
+            v[0] = (ImpGridVertex){ tl, HMM_V2(ttl.X, ttl.Y), color };
+            v[1] = (ImpGridVertex){ bl, HMM_V2(ttl.X, tbr.Y), color };
+            v[2] = (ImpGridVertex){ br, HMM_V2(tbr.X, tbr.Y), color };
+            v[3] = v[0];
+            v[4] = v[2];
+            v[5] = (ImpGridVertex){ tr, HMM_V2(tbr.X, ttl.Y), color };
+            grid->count += 6;
+        }
         start = HMM_AddV3(start, step);
         end = HMM_AddV3(end, step);
     }
 }
 
+void ImpUploadGrid(ImpGridCache *grid) {
+    if (grid->count > grid->gpu_capacity) {
+        if (grid->vao) {
+            rlUnloadVertexArray(grid->vao);
+            rlUnloadVertexBuffer(grid->vbo);
+        }
+        grid->gpu_capacity = MAX(grid->count*2, 1024);
+        grid->vao = rlLoadVertexArray();
+        rlEnableVertexArray(grid->vao);
+        grid->vbo = rlLoadVertexBuffer(0, grid->gpu_capacity*sizeof(ImpGridVertex), true);
+        rlSetVertexAttribute(0, 3, RL_FLOAT, false, sizeof(ImpGridVertex), (void *)offsetof(ImpGridVertex, pos));
+        rlEnableVertexAttribute(0);
+        rlSetVertexAttribute(1, 2, RL_FLOAT, false, sizeof(ImpGridVertex), (void *)offsetof(ImpGridVertex, uv));
+        rlEnableVertexAttribute(1);
+        rlSetVertexAttribute(3, 4, RL_UNSIGNED_BYTE, true, sizeof(ImpGridVertex), (void *)offsetof(ImpGridVertex, color));
+        rlEnableVertexAttribute(3);
+        rlDisableVertexArray();
+    }
+    if (grid->count) {
+        rlUpdateVertexBuffer(grid->vbo, grid->verts, grid->count*sizeof(ImpGridVertex), 0);
+    }
+}
+
+void ImpDrawGridCached(ImpGridCache *grid) {
+    if (!grid->vao || !grid->count) {
+        return;
+    }
+    ImpBeginVertexArrayDraw(WHITE, atlas.id);
+
+    const s32 GL_TRIANGLES = 4;
+    rlEnableVertexArray(grid->vao);
+    glDrawArrays(GL_TRIANGLES, 0, grid->count);
+
+    ImpEndVertexArrayDraw();
+}
+
 static HMM_Vec2 ImpMeasureText(str text) {
     HMM_Vec2 out = {0};
     for (s32 i = 0; i < text.len; i++) {
@@ -302,33 +1637,9 @@ s32 str_char_location(str s, char find) {
 
 #define N_GRID_LINES 11
 #define IMP_ABS(a) (((a) < 0)? -(a) : (a))
-static str ImpGetAxisLabelPrecision(ImpPlot* plot, f32 a, f32 b) {
-    s32 afprec = strf(imp, "%'.f", IMP_ABS(a)).len;
-    s32 bfprec = strf(imp, "%'.f", IMP_ABS(b)).len;
-    s32 aeprec = strf(imp, "%.e", IMP_ABS(a)).len;
-    s32 beprec = strf(imp, "%.e", IMP_ABS(b)).len;
-    s32 fprec = MAX(afprec, bfprec);
-    s32 eprec = MAX(aeprec, beprec);
-    s32 test = snprintf(0, 0, "%f", IMP_ABS(a));
-
-    fprec = strf(imp, "%.f", (b-a)/N_GRID_LINES).len;
-    eprec = strf(imp, "%.e", (b-a)/N_GRID_LINES).len;
-    
-    return strf(imp, "%%f");
-
-    if ((b-a)/N_GRID_LINES >= 1.0) {
-        if (fprec-2 < eprec) {
-            return strf(imp, "%%%d.f", MAX(fprec, 1));
-        } else {
-            return strf(imp, "%%%d.e", MAX(eprec, 1));
-        }
-    } else {
-        if (fprec-2 < eprec) {
-            return strf(imp, "%%.%df", MAX(fprec, 1));
-        } else {
-            return strf(imp, "%%.%de", MAX(eprec, 1));
-        }        
-    }
+/* NOTE: labels are N_GRID_LINES-1 steps across [a, b], precision follows from the step */
+static TickFormat ImpGetAxisTickFormat(ImpPlot* plot, f32 a, f32 b) {
+    return imp_tick_format((b-a)/(N_GRID_LINES-1), MAX(IMP_ABS(a), IMP_ABS(b)));
 }
 
 f32 modabsf(f32 x, f32 y) {
@@ -375,7 +1686,27 @@ void ImpDrawPlot(ImpPlot* plot, HMM_Vec3 camera_pos) {
     f32 my = modabsf(plot->plot_min.Y/plot->plot_scale.Y, 2*plot->view_radius.Y/(N_GRID_LINES-1));
     f32 mz = modabsf(plot->plot_min.Z/plot->plot_scale.Z, 2*plot->view_radius.Z/(N_GRID_LINES-1));
 
-    if (plot->flags & IMP_GRID_XY) {
+    ImpGridKey grid_key;
+    memset(&grid_key, 0, sizeof(grid_key));
+    grid_key.flags = plot->flags;
+    grid_key.plot_min = plot->plot_min;
+    grid_key.plot_max = plot->plot_max;
+    grid_key.plot_scale = plot->plot_scale;
+    grid_key.view_radius = plot->view_radius;
+    grid_key.billboard_z = plot->billboard_z;
+    grid_key.line_size = plot->line_size_f;
+    grid_key.side[0] = camera_pos.X > center.X;
+    grid_key.side[1] = camera_pos.Y > center.Y;
+    grid_key.side[2] = camera_pos.Z > center.Z;
+
+    b32 rebuild_grid = !plot->grid.valid || memcmp(&grid_key, &plot->grid.key, sizeof(grid_key));
+    if (rebuild_grid) {
+        plot->grid.key = grid_key;
+        plot->grid.valid = 1;
+        plot->grid.count = 0;
+    }
+
+    if (rebuild_grid && (plot->flags & IMP_GRID_XY)) {
         Color c = COLOR_GRID_LINE;
         /* c = (Color){.r=color.r, .g=color.g, .b=0xff, .a=color.a}; */
         
@@ -396,7 +1727,7 @@ void ImpDrawPlot(ImpPlot* plot, HMM_Vec3 camera_pos) {
         }
     }
 
-    if (plot->flags & IMP_GRID_ZX) {
+    if (rebuild_grid && (plot->flags & IMP_GRID_ZX)) {
         Color c = COLOR_GRID_LINE;
         /* c = (Color){.r=color.r, .g=0xff, .b=color.b, .a=color.a}; */
                     
@@ -417,7 +1748,7 @@ void ImpDrawPlot(ImpPlot* plot, HMM_Vec3 camera_pos) {
         }
     }
 
-    if (plot->flags & IMP_GRID_YZ) {
+    if (rebuild_grid && (plot->flags & IMP_GRID_YZ)) {
         Color c = COLOR_GRID_LINE;
         /* c = (Color){.r=0xff, .g=color.g, .b=color.b, .a=color.a}; */
         
@@ -436,6 +1767,11 @@ void ImpDrawPlot(ImpPlot* plot, HMM_Vec3 camera_pos) {
         }
     }
 
+    if (rebuild_grid) {
+        ImpUploadGrid(&plot->grid);
+    }
+    ImpDrawGridCached(&plot->grid);
+
     if (plot->flags & IMP_AXIS_X) {
         Color c = COLOR_AXES;
         s32 align_h = IMP_TEXT_ALIGN_CENTER;
@@ -455,7 +1791,7 @@ void ImpDrawPlot(ImpPlot* plot, HMM_Vec3 camera_pos) {
 
         ImpDrawLine(plot, lclosest, lend, c, 1);
 
-        plot->xtick_format = ImpGetAxisLabelPrecision(plot, plot->plot_min.X, plot->plot_max.X);
+        plot->xtick_format = ImpGetAxisTickFormat(plot, plot->plot_min.X, plot->plot_max.X);
         
         for (s32 i = 0; i < N_GRID_LINES+1; i++) {
             f32 x = (f64)i/(f64)(N_GRID_LINES-1);
@@ -466,10 +1802,7 @@ void ImpDrawPlot(ImpPlot* plot, HMM_Vec3 camera_pos) {
             f32 f = 0.2*num_text_size + plot->view_radius.X - fabs(p.bl.X);
             if (f > 0) {
                 f32 fade = CLAMP(f/(0.2*num_text_size), 0, 1);
-                str s = strf(imp, plot->xtick_format.str, HMM_Lerp(plot->plot_min.X, x, plot->plot_max.X) - mx*plot->plot_scale.X);
-                if (str_eq(s, imp_str("-0"))) {
-                    s = imp_str("0");
-                }
+                str s = imp_tick_label(imp, HMM_Lerp(plot->plot_min.X, x, plot->plot_max.X) - mx*plot->plot_scale.X, plot->xtick_format);
                 p = ImpAlignText(plot, p, ImpMeasureText(s), num_text_size, align_h, align_v);
                 c.a = 255*fade;
                 ImpDrawText3D(plot, p, s, c, num_text_size);
@@ -504,7 +1837,7 @@ void ImpDrawPlot(ImpPlot* plot, HMM_Vec3 camera_pos) {
 
         ImpDrawLine(plot, lclosest, lend, c, 1);
 
-        plot->ytick_format = ImpGetAxisLabelPrecision(plot, plot->plot_min.Y, plot->plot_max.Y);
+        plot->ytick_format = ImpGetAxisTickFormat(plot, plot->plot_min.Y, plot->plot_max.Y);
 
         for (s32 i = 0; i < N_GRID_LINES+1; i++) {
             f32 y = (f64)i/(f64)(N_GRID_LINES-1);
@@ -515,10 +1848,7 @@ void ImpDrawPlot(ImpPlot* plot, HMM_Vec3 camera_pos) {
             f32 f = 0.2*num_text_size + plot->view_radius.Y - fabs(p.bl.Y);
             if (f > 0) {
                 f32 fade = CLAMP(f/(0.5*num_text_size), 0, 1);
-                str s = strf(imp, plot->ytick_format.str, HMM_Lerp(plot->plot_min.Y, y, plot->plot_max.Y) - my*plot->plot_scale.Y);
-                if (str_eq(s, imp_str("-0"))) {
-                    s = imp_str("0");
-                }
+                str s = imp_tick_label(imp, HMM_Lerp(plot->plot_min.Y, y, plot->plot_max.Y) - my*plot->plot_scale.Y, plot->ytick_format);
                 
                 p = ImpAlignText(plot, p, ImpMeasureText(s), num_text_size, align_h, align_v);
                 c.a = 255*fade;
@@ -556,17 +1886,14 @@ void ImpDrawPlot(ImpPlot* plot, HMM_Vec3 camera_pos) {
         
         ImpDrawLine(plot, lclosest, lend, c, 1);
 
-        plot->ztick_format = ImpGetAxisLabelPrecision(plot, plot->plot_min.Z, plot->plot_max.Z);
+        plot->ztick_format = ImpGetAxisTickFormat(plot, plot->plot_min.Z, plot->plot_max.Z);
         
         for (s32 i = 0; i < N_GRID_LINES; i++) {
             f32 z = (f64)i/(f64)(N_GRID_LINES-1);
             ImpDrawPlane p = plot->billboard;
             p.bl = HMM_MulV3F(closest, num_percent_offset.Z);
             p.bl.Z = HMM_Lerp(closest.Z, z, end.Z) - mz;
-            str s = strf(imp, plot->ztick_format.str, HMM_Lerp(plot->plot_min.Z, z, plot->plot_max.Z) - mz*plot->plot_scale.Z);
-            if (str_eq(s, imp_str("-0"))) {
-                s = imp_str("0");
-            }
+            str s = imp_tick_label(imp, HMM_Lerp(plot->plot_min.Z, z, plot->plot_max.Z) - mz*plot->plot_scale.Z, plot->ztick_format);
              
             p = ImpAlignText(plot, p, ImpMeasureText(s), num_text_size, align_h, align_v);
             ImpDrawText3D(plot, p, s, c, num_text_size);
@@ -698,6 +2025,18 @@ int main(void)
 
     s32 points = 1 << 12;
     f32 t = 0;
+    ImpSeriesCache static_series = {0};
+    ImpStripBuffer series_strip = {0};
+    ImpSeriesChunks series_chunks = {0};
+    ImpSeriesChunks static_chunks = {0};
+    ImpSeriesBVH series_bvh = {0};
+    ImpSeriesBVH static_bvh = {0};
+    f64 bvh_build_ms = 0, bvh_refit_ms = 0, pick_ms = 0;
+    ImpDepthSort marker_sort = {0};
+    /* NOTE: one per chunk, used by the run of visible chunks starting there, so each run
+       keeps sorting the same segments */
+    ImpDepthSort *series_sort = 0;
+    s32 series_sort_count = 0;
     HMM_Vec3 *point = malloc(sizeof(HMM_Vec3)*(1 << 17));
     HMM_Vec3 *point2 = malloc(sizeof(HMM_Vec3)*(1 << 17));
     for (s32 i = 0; i < points; i++) {
@@ -714,6 +2053,26 @@ int main(void)
         };
     }
 
+    /* Scatter test: a fuzzy shell around the curves, drawn through the octree */
+    s32 cloud_n = 1 << 21;
+    HMM_Vec3 *cloud = malloc(cloud_n*sizeof(HMM_Vec3));
+    for (s32 i = 0; i < cloud_n; i++) {
+        f32 u = 2*(f32)rand()/RAND_MAX - 1;
+        f32 a = 6.283185307*(f32)rand()/RAND_MAX;
+        f32 radius = 1.5 + 0.1*(f32)rand()/RAND_MAX;
+        f32 s = sqrtf(1 - u*u);
+        cloud[i] = HMM_V3(2.5 + radius*s*cos(a), 2.5 + radius*s*sin(a), 2.5 + radius*u);
+    }
+    ImpOctree octree;
+    ImpBuildOctree(&octree, cloud, cloud_n);
+    free(cloud);
+
+    /* Surface test */
+    s32 surface_w = 512, surface_h = 512;
+    f32 *heights = malloc(surface_w*surface_h*sizeof(f32));
+    ImpSurface surface;
+    ImpInitSurface(&surface, surface_w, surface_h, 0.5, 0.5, 4.0/(surface_w - 1), 4.0/(surface_h - 1));
+
     while (!WindowShouldClose()) {
         if (IsKeyDown(KEY_W)) {
             Plot.plot_min.X += t*t;
@@ -818,7 +2177,7 @@ int main(void)
         HMM_Mat4 modelview = HMM_MulM4(Plot.camera, Plot.plot_rotation);
         HMM_Mat4 modelview_inv = HMM_InvGeneralM4(modelview);
 
-        imp_begin(imp, (Inputs){0});
+        imp_begin(imp, (Inputs){ .dt = GetFrameTime() });
 
         BeginDrawing();
 
@@ -877,17 +2236,69 @@ int main(void)
                 /* ); */
             /* } */
         }
-        for (s32 i = 0; i < points-1; i++) {
-            ImpDrawLine(&Plot, point2[i], point2[i+1], color, 4.0);
-            
-            /* Rectangle rect = atlas_rect[IMP_MARKER_CIRCLE + (i % IMP_MARKER_COUNT)]; */
-            /* ImpDrawPlane p = plane; */
-            /* p.bl = point2[i]; */
-            /* ImpDrawTexQuadFromAtlas(p, rect, color); */
+        rlEnd();
+
+        s32 chunk, first, count;
+        ImpBuildChunks(&series_chunks, point2, points);
+        f64 bvh_start = GetTime();
+        ImpRefitBVH(&series_bvh, &series_chunks, 0);
+        bvh_refit_ms = 1000*(GetTime() - bvh_start);
+        ImpCullChunks(&Plot, &series_chunks);
+        if (series_sort_count < series_chunks.count) {
+            series_sort = realloc(series_sort, series_chunks.count*sizeof(ImpDepthSort));
+            memset(series_sort + series_sort_count, 0, (series_chunks.count - series_sort_count)*sizeof(ImpDepthSort));
+            series_sort_count = series_chunks.count;
         }
+        for (chunk = 0; ImpNextChunkRun(&series_chunks, &chunk, &first, &count);) {
+            ImpDrawPolylineClipped(&Plot, &series_strip, series_sort + first/IMP_CHUNK_SIZE, point2 + first, count, color, 4.0);
+        }
+        ImpDrawMarkersSorted(&marker_sort, plane, point2, points, IMP_MARKER_CIRCLE, Fade(color, 0.5));
         Plot.plotting = 0;
-        
-        rlEnd();
+
+        /* point never changes, so after the first upload this only costs a matrix update */
+        ImpUploadSeries(&static_series, point, points, 0);
+        if (static_chunks.n != points) {
+            f64 build_start = GetTime();
+            ImpBuildChunks(&static_chunks, point, points);
+            ImpRefitBVH(&static_bvh, &static_chunks, 0);
+            bvh_build_ms = 1000*(GetTime() - build_start);
+        }
+        ImpCullChunks(&Plot, &static_chunks);
+        for (chunk = 0; ImpNextChunkRun(&static_chunks, &chunk, &first, &count);) {
+            ImpDrawSeriesCached(&static_series, first, count, BLUE);
+        }
+
+        /* Pick whichever series is nearest under the mouse */
+        f64 pick_start = GetTime();
+        ImpRay ray = ImpMouseRay(&Plot, modelview_inv, HMM_V2(GetMouseX(), GetMouseY()),
+                                 HMM_V2(GetScreenWidth(), GetScreenHeight()), 6);
+        ImpPick pick = ImpPickSeries(&series_bvh, point2, points, ray);
+        ImpPick static_pick = ImpPickSeries(&static_bvh, point, points, ray);
+        const char *picked_series = "red";
+        if (static_pick.hit && (!pick.hit || static_pick.t < pick.t)) {
+            pick = static_pick;
+            picked_series = "blue";
+        }
+        pick_ms = 1000*(GetTime() - pick_start);
+        if (pick.hit) {
+            ImpDrawPlane p = plane;
+            p.bl = HMM_SubV3(pick.point, HMM_MulV3F(HMM_AddV3(plane.r, plane.u), 1.0));
+            p.r = HMM_MulV3F(plane.r, 2);
+            p.u = HMM_MulV3F(plane.u, 2);
+            ImpDrawTexQuadFromAtlas(p, atlas_rect[IMP_MARKER_CIRCLE_OUTLINE], BLACK);
+        }
+
+        ImpSelectOctreeNodes(&octree, GetScreenHeight());
+        ImpDrawOctree(&octree, DARKGREEN);
+
+        for (s32 j = 0; j < surface_h; j++) {
+            for (s32 i = 0; i < surface_w; i++) {
+                f32 x = surface.x0 + i*surface.dx, y = surface.y0 + j*surface.dy;
+                heights[j*surface_w + i] = 0.5 + 0.25*sin(2*x + t)*cos(3*y - t);
+            }
+        }
+        ImpUpdateSurface(&surface, heights);
+        ImpDrawSurface(&surface, GetScreenHeight(), DARKBLUE, ORANGE);
         rlDisableDepthTest();
 
 
@@ -899,6 +2310,19 @@ int main(void)
 
 
         DrawFPS(8, 8);
+        DrawText(TextFormat("chunks drawn: %d culled: %d",
+                            series_chunks.drawn + static_chunks.drawn, series_chunks.culled + static_chunks.culled),
+                 8, 32, 20, DARKGRAY);
+        DrawText(TextFormat("octree nodes: %d/%d points: %d budget: %d", octree.selected_count, octree.node_count,
+                            octree.selected_points, octree.budget),
+                 8, 56, 20, DARKGRAY);
+        DrawText(TextFormat("surface %dx%d lod step: %d", surface.w, surface.h, surface.step), 8, 80, 20, DARKGRAY);
+        DrawText(TextFormat("bvh build: %.3fms refit: %.3fms pick: %.3fms", bvh_build_ms, bvh_refit_ms, pick_ms),
+                 8, 104, 20, DARKGRAY);
+        if (pick.hit) {
+            DrawText(TextFormat("picked %s point %d (%.3g, %.3g, %.3g)", picked_series, pick.nearest,
+                                pick.point.X, pick.point.Y, pick.point.Z), 8, 128, 20, DARKGRAY);
+        }
         /* DrawTexture(atlas, 0, 0, RED); */
         
         EndDrawing();
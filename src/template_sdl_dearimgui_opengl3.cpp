@@ -98,11 +98,28 @@ int main(int, char**)
     bool show_demo_window = true;
     bool show_another_window = false;
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
+
+    // Event driven mode: while idle, block in SDL_WaitEventTimeout instead of redrawing every frame.
+    // Input or a pushed data_event (see below) wakes the loop up, then a few frames are drawn so imgui can settle.
+    bool event_driven = true;
+    int redraw_frames = 3;
+    // Data producers can wake the loop from any thread with:
+    //     SDL_Event e = {}; e.type = data_event; SDL_PushEvent(&e);
+    Uint32 data_event = SDL_RegisterEvents(1);
+    (void)data_event;
     
     // Main loop
     bool done = false;
     while (!done)
     {
+        // Block until an event arrives, leaving it in the queue for the poll loop below
+        if (event_driven && redraw_frames <= 0)
+        {
+            if (!SDL_WaitEventTimeout(NULL, 500))
+                continue;
+        }
+        redraw_frames--;
+
         // Poll and handle events (inputs, window resize, etc.)
         // You can read the io.WantCaptureMouse, io.WantCaptureKeyboard flags to tell if dear imgui wants to use your inputs.
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
@@ -111,6 +128,7 @@ int main(int, char**)
         SDL_Event event;
         while (SDL_PollEvent(&event))
         {
+            redraw_frames = 3;
             ImGui_ImplSDL2_ProcessEvent(&event);
             if (event.type == SDL_QUIT)
                 done = true;
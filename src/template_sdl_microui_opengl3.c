@@ -28,6 +28,23 @@ void r_present(void);
 #include "imp.h"
 static Context *imp;
 
+void r_draw_rects(const Rect *rects, int count, mu_Color color);
+void r_draw_text_clipped(const char *text, mu_Vec2 pos, mu_Color color, Rect clip);
+int r_draw_series(Data *data, Rect screen, Vec2 offset);
+void r_draw_lines(Data *data, Rect screen, Vec2 offset, f32 thickness);
+static void flush(void);
+static double frame_cpu_ms;
+static float frame_dt;
+/* NOTE(lcf): set by the f key, fits the plot view to its data on the next frame */
+static b32 fit_requested = 0;
+/* NOTE(lcf): the l key cycles the y axis of Test 1 through linear, log10 and symlog */
+static s32 test_scale_y = IMP_SCALE_LINEAR;
+/* NOTE(lcf): scrolling plot of a fake 1kHz signal. It keeps the main loop awake, so turn it
+   off to see the idle behaviour. */
+static b32 live_demo = 1;
+static Stream live_stream;
+static SDL_Window *window;
+
 ////////////////////////////////
 //~ Main UI Code
 
@@ -144,17 +161,43 @@ static void plot_window(mu_Context *ctx) {
     Inputs imp_input = {
         .mouse = {ctx->mouse_pos.x, ctx->mouse_pos.y},
         .mouse_down = ctx->mouse_down,
-        .mouse_scroll = ctx->scroll_delta.y/30
+        .mouse_scroll = ctx->scroll_delta.y/30,
+        .dt = frame_dt,
     };
 
     imp_begin(imp, imp_input);
     if (mu_begin_window(ctx, "Plot Window", mu_rect(0, 0, 800, 600))) {
-        mu_layout_set_next(ctx, mu_rect(0, 0, 750, 520), 1);
+        mu_layout_row(ctx, 1, (int[]) { 750 }, live_demo? 300 : 520);
         mu_Rect r = mu_layout_next(ctx);
         Rect impr = {.x = r.x, .y = r.y, .w = r.w, .h=r.h};
-        begin_plot(imp, impr, imp_str("Test 1"));
+        Plot *plot = begin_plot(imp, impr, imp_str("Test 1"));
+        plot->flags |= IMP_PLOT_DRAW_STATS;
+        plot->scale_y = test_scale_y;
+        if (fit_requested) {
+            imp_plot_autofit(plot, 0.05);
+            fit_requested = 0;
+        }
 
         end_plot(imp);
+
+        if (live_demo) {
+            /* Catch the stream up to now, then let it drive the view */
+            static f64 live_t;
+            f64 now = SDL_GetTicks()/1000.0;
+            for (; live_t < now; live_t += 0.001) {
+                imp_stream_push(&live_stream, live_t, sin(live_t) + 0.3*sin(7.3*live_t) + 0.1*rand()/RAND_MAX);
+            }
+
+            mu_layout_row(ctx, 1, (int[]) { 750 }, 210);
+            r = mu_layout_next(ctx);
+            impr = (Rect){.x = r.x, .y = r.y, .w = r.w, .h=r.h};
+            plot = begin_plot(imp, impr, imp_str("Live"));
+            imp_stream_data(&live_stream, &plot->data[0]);
+            plot->data[0].flags = IMP_DATA_LINES;
+            plot->flags |= IMP_PLOT_TIME_X;
+            imp_stream_autoscale(plot, &live_stream, 0.05);
+            end_plot(imp);
+        }
         mu_end_window(ctx);
     }
     imp_end(imp);
@@ -247,6 +290,42 @@ static int imp_text_width(const void *unused, const char *text, s32 len) {
 //~ Entry Point
 static b32 in_imp = 0;
 
+/* NOTE(lcf): in event driven mode the main loop blocks while idle, and only wakes up for
+   input, data_event, or while a plot view is still animating. */
+static b32 event_driven = 1;
+static Uint32 data_event;
+#define IDLE_TIMEOUT_MS 500
+
+/* NOTE(lcf): late_latch re-reads the mouse right before submitting imp commands and shifts
+   a dragged plot by however far it moved since imp_begin. measure_latency shows input to
+   present time in the title, it calls glFinish after every swap so leave it off otherwise. */
+static b32 late_latch = 1;
+static b32 measure_latency = 0;
+static Uint32 input_ticks;
+static double input_latency_ms;
+static double latch_latency_ms;
+
+/* Shifts a rect by a late pan offset and clips it back to the plot */
+static Rect offset_rect(Rect r, Vec2 offset, Rect clip) {
+    f32 x0 = mu_max(r.x + offset.x, clip.x);
+    f32 y0 = mu_max(r.y + offset.y, clip.y);
+    f32 x1 = mu_min(r.x + r.w + offset.x, clip.x + clip.w);
+    f32 y1 = mu_min(r.y + r.h + offset.y, clip.y + clip.h);
+    return (Rect){ .x = x0, .y = y0, .w = mu_max(x1 - x0, 0), .h = mu_max(y1 - y0, 0) };
+}
+
+/* Data producers call this (from any thread) after changing plot data */
+void post_data_event(void) {
+    SDL_Event e = { .type = data_event };
+    SDL_PushEvent(&e);
+}
+
+static Uint32 live_tick(Uint32 interval, void *param) {
+    (void)param;
+    post_data_event();
+    return interval;
+}
+
 int main(int argc, char **argv) {
     /* init SDL and renderer */
     SDL_Init(SDL_INIT_EVERYTHING);
@@ -261,15 +340,35 @@ int main(int argc, char **argv) {
     /* init imp */
     imp = malloc(sizeof(Context));
     imp_init(imp, imp_text_width, 0, text_height(ctx->style->font));
+
+    data_event = SDL_RegisterEvents(1);
+    if (live_demo) {
+        imp_stream_init(&live_stream, 1 << 16, 10.0);
+        SDL_AddTimer(16, live_tick, 0);
+    }
     
     /* main loop */
+    s32 redraw_frames = 2;
     for (;;) {
+        /* block until something happens, leaving the event in the queue */
+        if (event_driven && redraw_frames <= 0 && !imp->animating) {
+            if (!SDL_WaitEventTimeout(NULL, IDLE_TIMEOUT_MS)) {
+                continue;
+            }
+        }
+        redraw_frames--;
+
         /* handle SDL events */
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
+            /* microui reacts to input a frame late, so draw one extra */
+            redraw_frames = 2;
             switch (e.type) {
                 case SDL_QUIT: exit(0); break;
-                case SDL_MOUSEMOTION: mu_input_mousemove(ctx, e.motion.x, e.motion.y); break;
+                case SDL_MOUSEMOTION: {
+                    mu_input_mousemove(ctx, e.motion.x, e.motion.y);
+                    if (!input_ticks) { input_ticks = e.motion.timestamp; }
+                } break;
                 case SDL_MOUSEWHEEL: mu_input_scroll(ctx, 0, e.wheel.y * -30); break;
                 case SDL_TEXTINPUT: mu_input_text(ctx, e.text.text); break;
                 
@@ -287,13 +386,37 @@ int main(int argc, char **argv) {
                     if (c && e.type == SDL_KEYDOWN) { mu_input_keydown(ctx, c); }
                     if (c && e.type ==   SDL_KEYUP) { mu_input_keyup(ctx, c);   }
                     if (e.key.keysym.sym == SDLK_ESCAPE) { exit(0); }
+                    if (e.key.keysym.sym == SDLK_f && e.type == SDL_KEYDOWN) { fit_requested = 1; }
+                    if (e.key.keysym.sym == SDLK_l && e.type == SDL_KEYDOWN) {
+                        test_scale_y = (test_scale_y + 1) % (IMP_SCALE_SYMLOG + 1);
+                        fit_requested = 1;
+                    }
                     break;
                 }
             }
         }
         
+        Uint64 frame_start = SDL_GetPerformanceCounter();
+        static Uint64 last_frame_start;
+        frame_dt = last_frame_start? (double)(frame_start - last_frame_start)/SDL_GetPerformanceFrequency() : 0;
+        last_frame_start = frame_start;
+
         /* process frame */
         process_frame(ctx);
+
+        /* skip rendering and swapping if neither microui nor imp output changed */
+        static Uint32 ui_hash;
+        Uint32 h = HASH_INITIAL;
+        hash_words(&h, ctx->command_list.items, ctx->command_list.idx);
+        b32 changed = imp->changed || (h != ui_hash);
+        ui_hash = h;
+        if (!changed) {
+            input_ticks = 0;
+            if (!event_driven) {
+                SDL_Delay(16);
+            }
+            continue;
+        }
         
         /* render */
         r_clear(mu_color(bg[0], bg[1], bg[2], 255));
@@ -307,42 +430,123 @@ int main(int argc, char **argv) {
             }
         }
 
-        Command c;
+        Command *c = NULL;
+
+        Vec2 latest_mouse = {0};
+        Uint64 latch_time = 0;
+        if (late_latch) {
+            int mx, my;
+            SDL_PumpEvents();
+            SDL_GetMouseState(&mx, &my);
+            latest_mouse = (Vec2){mx, my};
+            latch_time = SDL_GetPerformanceCounter();
+        }
        
         in_imp = 1;
         while (imp_next_command(imp, &c)) {
-
+            Plot *plot = command_plot(imp, c);
+            Vec2 offset = late_latch? imp_late_pan_offset(imp, plot, latest_mouse) : (Vec2){0};
                        
-            switch (c.type) {
+            switch (c->type) {
             case IMP_COMMAND_RECT: {
-                Rect r = c.rect.screen;
-                r_draw_rect((mu_Rect) { .x = r.x, .y = r.y, .w = r.w, .h = r.h }, PCAST(mu_Color, c.base.color));
+                Rect r = c->rect.screen;
+                r_draw_rect((mu_Rect) { .x = r.x, .y = r.y, .w = r.w, .h = r.h }, PCAST(mu_Color, c->base.color));
             } break;
             case IMP_COMMAND_TEXT: {
-                Rect r = c.text.screen;
-                r_draw_text(c.text.text.str, (mu_Vec2){ .x = r.x, .y = r.y}, PCAST(mu_Color, c.base.color));
+                /* Labels move with the grid they belong to, clipped to the plot like it */
+                Rect r = c->text.screen;
+                mu_Vec2 pos = { .x = r.x + offset.x, .y = r.y + offset.y };
+                r_draw_text_clipped(c->text.text.str, pos, PCAST(mu_Color, c->base.color), plot->screen);
+            } break;
+            case IMP_COMMAND_RECT_LIST: {
+                r_draw_rects(c->rect_list.rects, c->rect_list.count, PCAST(mu_Color, c->base.color));
             } break;
             case IMP_COMMAND_DATA: {
-                /* TODO(lcf): this is just a test, should use imp methods to get datapoints  */
-                Data data = c.data.data;
-                mu_Color color = PCAST(mu_Color, data.color);
-                for (s32 i = 0; i < data.n; i++) {
-                    Vec2 p = {data.x[i], data.y[i]};
-                    if (point_in_rect(data.view, p)) {
+                if (r_draw_series(&c->data.data, c->data.screen, offset)) {
+                    break;
+                }
+
+                /* No vertex buffers, fall back to tessellated lines and points as rects */
+                Data *data = &c->data.data;
+                if (data->flags & IMP_DATA_LINES) {
+                    r_draw_lines(data, c->data.screen, offset, 1.5);
+                }
+                if (!(data->flags & IMP_DATA_MARKERS)) {
+                    break;
+                }
+                mu_Color color = PCAST(mu_Color, data->color);
+                Rect rects[256];
+                s32 n = 0;
+                for (s32 i = 0; i < data->n; i++) {
+                    Vec2 p = {data->x[i], data->y[i]};
+                    if (point_in_rect(data->view, p)) {
                         s32 s = 2;
-                        p = view_to_screen_raw(data.view, c.data.screen, p);
-                        mu_Rect r = {.x = p.x - s/2, .y = p.y - s/2, .w=s, .h=s};
-                        r_draw_rect(r, color);
+                        p = view_to_screen_raw(data->view, c->data.screen, p);
+                        Rect r = {.x = p.x - s/2, .y = p.y - s/2, .w=s, .h=s};
+                        rects[n++] = offset_rect(r, offset, c->data.screen);
+                        if (n == 256) { r_draw_rects(rects, n, color); n = 0; }
+                    }
+                }
+                r_draw_rects(rects, n, color);
+            } break;
+            case IMP_COMMAND_GRID: {
+                mu_Color color = PCAST(mu_Color, c->base.color);
+                Rect rects[256];
+                for (s32 i = 0; i < c->grid.count; i += 256) {
+                    s32 n = mu_min(256, c->grid.count - i);
+                    for (s32 j = 0; j < n; j++) {
+                        rects[j] = offset_rect(grid_line_rect(&c->grid, i + j), offset, plot->screen);
                     }
+                    r_draw_rects(rects, n, color);
                 }
-                    
+            } break;
+            case IMP_COMMAND_HIGHLIGHT: {
+                /* Ring in the series color around a dot in the background color */
+                Vec2 p = c->highlight.screen;
+                p.x += offset.x; p.y += offset.y;
+                Rect ring[4] = {
+                    {.x = p.x - 5, .y = p.y - 5, .w = 10, .h = 2},
+                    {.x = p.x - 5, .y = p.y + 3, .w = 10, .h = 2},
+                    {.x = p.x - 5, .y = p.y - 3, .w = 2, .h = 6},
+                    {.x = p.x + 3, .y = p.y - 3, .w = 2, .h = 6},
+                };
+                Rect dot = {.x = p.x - 2, .y = p.y - 2, .w = 4, .h = 4};
+                imp_Color background = color(PLOTBG);
+                r_draw_rects(ring, 4, PCAST(mu_Color, c->base.color));
+                r_draw_rects(&dot, 1, PCAST(mu_Color, background));
             } break;
             case IMP_COMMAND_CUSTOM: {} break;
             }
         }
         in_imp = 0;
+
+        flush();
+        Uint64 frame_end = SDL_GetPerformanceCounter();
+        frame_cpu_ms = 0.9*frame_cpu_ms + 0.1*1000.0*(frame_end - frame_start)/SDL_GetPerformanceFrequency();
+
+        /* NOTE(lcf): shown in the title so the readout doesn't mark the ui as changed */
+        char title[128];
+        if (measure_latency) {
+            sprintf(title, "imp - frame cpu: %.3f ms, input to present: %.1f ms, latched to present: %.2f ms",
+                    frame_cpu_ms, input_latency_ms, latch_latency_ms);
+        } else {
+            sprintf(title, "imp - frame cpu: %.3f ms", frame_cpu_ms);
+        }
+        SDL_SetWindowTitle(window, title);
         
         r_present();
+
+        if (measure_latency) {
+            /* NOTE(lcf): swap only queues the frame, wait for it to actually finish */
+            glFinish();
+            if (input_ticks) {
+                input_latency_ms = SDL_GetTicks() - input_ticks;
+            }
+            if (latch_time) {
+                latch_latency_ms = 1000.0*(SDL_GetPerformanceCounter() - latch_time)/SDL_GetPerformanceFrequency();
+            }
+        }
+        input_ticks = 0;
     }
     
     return 0;
@@ -354,16 +558,37 @@ int main(int argc, char **argv) {
 #define BUFFER_SIZE 0xf0000
 
 static GLfloat   tex_buf[BUFFER_SIZE *  2*4];
-static GLfloat  vert_buf[BUFFER_SIZE *  3*];
+static GLfloat  vert_buf[BUFFER_SIZE *  2*4];
 static GLubyte color_buf[BUFFER_SIZE * 16];
 static GLuint  index_buf[BUFFER_SIZE *  6];
 
+/* NOTE(lcf): series are kept on the gpu in view space, keyed by their x pointer. They
+   are re-uploaded when their version or y pointer changes (a log scale was switched on), and
+   only the new tail when n grows. A slot nothing drew from last frame is handed to the next
+   new pointer, with its buffer, since ring buffers move their start on every push. */
+typedef struct SeriesCache SeriesCache;
+struct SeriesCache {
+    const f32 *x;
+    const f32 *y;
+    u64 frame;
+    u32 version;
+    s32 uploaded;
+    s32 capacity;
+    GLuint vbo;
+};
+static SeriesCache series_cache[IMP_MAX_PLOTS*IMP_MAX_DATA];
+static GLfloat *series_staging;
+static s32 series_staging_size;
+
+static PFNGLGENBUFFERSPROC r_glGenBuffers;
+static PFNGLBINDBUFFERPROC r_glBindBuffer;
+static PFNGLBUFFERDATAPROC r_glBufferData;
+static PFNGLBUFFERSUBDATAPROC r_glBufferSubData;
+
 static int width  = 800;
 static int height = 600;
 static int buf_idx;
 
-static SDL_Window *window;
-
 
 
 void r_init(void) {
@@ -372,6 +597,7 @@ void r_init(void) {
                               NULL, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
                               width, height, SDL_WINDOW_OPENGL );
     SDL_GL_CreateContext(window);
+    SDL_GL_SetSwapInterval(1); /* vsync, caps the frame rate while redrawing */
     
     /* init gl */
     glEnable(GL_BLEND);
@@ -393,6 +619,22 @@ void r_init(void) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     assert(glGetError() == 0);
+
+    /* vertex buffers are gl 1.5, only used if present */
+    r_glGenBuffers = SDL_GL_GetProcAddress("glGenBuffers");
+    r_glBindBuffer = SDL_GL_GetProcAddress("glBindBuffer");
+    r_glBufferData = SDL_GL_GetProcAddress("glBufferData");
+    r_glBufferSubData = SDL_GL_GetProcAddress("glBufferSubData");
+
+    /* quad indices never change, so fill the index buffer once */
+    for (int i = 0; i < BUFFER_SIZE; i++) {
+        index_buf[i*6 + 0] = i*4 + 0;
+        index_buf[i*6 + 1] = i*4 + 1;
+        index_buf[i*6 + 2] = i*4 + 2;
+        index_buf[i*6 + 3] = i*4 + 2;
+        index_buf[i*6 + 4] = i*4 + 3;
+        index_buf[i*6 + 5] = i*4 + 1;
+    }
 }
 
 
@@ -406,7 +648,11 @@ static void flush(void) {
     glOrtho(0.0f, width, height, 0.0f, -1.0f, +1.0f);
     glMatrixMode(GL_MODELVIEW);
     glPushMatrix();
-    glLoadMatrixf(imp->first_plot->camera.Elements);
+    if (imp->first_plot) {
+        glLoadMatrixf(imp->first_plot->camera.Elements[0]);
+    } else {
+        glLoadIdentity();
+    }
     glMatrixMode(GL_MODELVIEW);
     
     if (in_imp) {
@@ -437,8 +683,6 @@ static void push_quad(mu_Rect dst, mu_Rect src, mu_Color color) {
     
     int texvert_idx = buf_idx *  8;
     int   color_idx = buf_idx * 16;
-    int element_idx = buf_idx *  4;
-    int   index_idx = buf_idx *  6;
     buf_idx++;
     
     /* update texture buffer */
@@ -470,14 +714,198 @@ static void push_quad(mu_Rect dst, mu_Rect src, mu_Color color) {
     memcpy(color_buf + color_idx +  4, &color, 4);
     memcpy(color_buf + color_idx +  8, &color, 4);
     memcpy(color_buf + color_idx + 12, &color, 4);
-    
-    /* update index buffer */
-    index_buf[index_idx + 0] = element_idx + 0;
-    index_buf[index_idx + 1] = element_idx + 1;
-    index_buf[index_idx + 2] = element_idx + 2;
-    index_buf[index_idx + 3] = element_idx + 2;
-    index_buf[index_idx + 4] = element_idx + 3;
-    index_buf[index_idx + 5] = element_idx + 1;
+}
+
+
+/* Same as push_quad for a run of untextured rects sharing one color */
+void r_draw_rects(const Rect *rects, int count, mu_Color color) {
+    mu_Rect src = atlas[ATLAS_WHITE];
+    float tx = (src.x + src.w/2) / (float) ATLAS_WIDTH;
+    float ty = (src.y + src.h/2) / (float) ATLAS_HEIGHT;
+    unsigned int rgba;
+    memcpy(&rgba, &color, 4);
+
+    while (count > 0) {
+        if (buf_idx == BUFFER_SIZE) { flush(); }
+        int n = mu_min(count, BUFFER_SIZE - buf_idx);
+
+        GLfloat *tex = tex_buf + buf_idx*8;
+        GLfloat *vert = vert_buf + buf_idx*8;
+        unsigned int *col = (unsigned int *)(color_buf + buf_idx*16);
+        for (int i = 0; i < n; i++) {
+            Rect r = rects[i];
+            vert[0] = r.x;       vert[1] = r.y;
+            vert[2] = r.x + r.w; vert[3] = r.y;
+            vert[4] = r.x;       vert[5] = r.y + r.h;
+            vert[6] = r.x + r.w; vert[7] = r.y + r.h;
+            for (int j = 0; j < 8; j += 2) { tex[j] = tx; tex[j+1] = ty; }
+            col[0] = col[1] = col[2] = col[3] = rgba;
+            vert += 8; tex += 8; col += 4;
+        }
+
+        buf_idx += n;
+        rects += n;
+        count -= n;
+    }
+}
+
+
+/* interleaves x/y of points [first, last) into the staging buffer */
+static GLfloat *series_interleave(Data *data, s32 first, s32 last) {
+    s32 size = (last - first)*2;
+    if (size > series_staging_size) {
+        series_staging_size = size*2;
+        series_staging = realloc(series_staging, series_staging_size*sizeof(GLfloat));
+    }
+    for (s32 i = first; i < last; i++) {
+        series_staging[(i-first)*2 + 0] = data->x[i];
+        series_staging[(i-first)*2 + 1] = data->y[i];
+    }
+    return series_staging;
+}
+
+
+static SeriesCache *series_upload(Data *data) {
+    SeriesCache *cache = 0;
+    for (s32 i = 0; i < IMP_MAX_PLOTS*IMP_MAX_DATA; i++) {
+        if (series_cache[i].x == data->x) { cache = series_cache + i; break; }
+        if (!cache && (!series_cache[i].x || series_cache[i].frame + 1 < imp->counter)) { cache = series_cache + i; }
+    }
+    if (!cache) { return 0; }
+    cache->frame = imp->counter;
+
+    if (!cache->vbo) { r_glGenBuffers(1, &cache->vbo); }
+    r_glBindBuffer(GL_ARRAY_BUFFER, cache->vbo);
+
+    b32 same = (cache->x == data->x) && (cache->y == data->y) && (cache->version == data->version) && (data->n >= cache->uploaded);
+    if (same && data->n <= cache->capacity) {
+        /* appended tail only */
+        if (data->n > cache->uploaded) {
+            r_glBufferSubData(GL_ARRAY_BUFFER, cache->uploaded*2*sizeof(GLfloat), (data->n - cache->uploaded)*2*sizeof(GLfloat),
+                              series_interleave(data, cache->uploaded, data->n));
+        }
+    } else {
+        if (data->n > cache->capacity) {
+            cache->capacity = data->n*2;
+            r_glBufferData(GL_ARRAY_BUFFER, cache->capacity*2*sizeof(GLfloat), 0, GL_DYNAMIC_DRAW);
+        }
+        r_glBufferSubData(GL_ARRAY_BUFFER, 0, data->n*2*sizeof(GLfloat), series_interleave(data, 0, data->n));
+    }
+
+    cache->x = data->x;
+    cache->y = data->y;
+    cache->version = data->version;
+    cache->uploaded = data->n;
+    return cache;
+}
+
+
+/* Draws a triangle strip (from tessellate_polyline) as quads between consecutive vertex pairs,
+   so it shares the quad index buffer with everything else */
+static void r_draw_strip(const HMM_Vec3 *verts, int count, mu_Color color) {
+    mu_Rect src = atlas[ATLAS_WHITE];
+    float tx = (src.x + src.w/2) / (float) ATLAS_WIDTH;
+    float ty = (src.y + src.h/2) / (float) ATLAS_HEIGHT;
+    unsigned int rgba;
+    memcpy(&rgba, &color, 4);
+
+    for (int k = 0; k + 3 < count; k += 2) {
+        if (buf_idx == BUFFER_SIZE) { flush(); }
+        GLfloat *tex = tex_buf + buf_idx*8;
+        GLfloat *vert = vert_buf + buf_idx*8;
+        unsigned int *col = (unsigned int *)(color_buf + buf_idx*16);
+        for (int j = 0; j < 4; j++) {
+            vert[j*2 + 0] = verts[k + j].X;
+            vert[j*2 + 1] = verts[k + j].Y;
+            tex[j*2 + 0] = tx;
+            tex[j*2 + 1] = ty;
+            col[j] = rgba;
+        }
+        buf_idx++;
+    }
+}
+
+/* Lines for when there are no vertex buffers. Clipped to the view in data space, then
+   tessellated in screen space so width is in pixels. */
+void r_draw_lines(Data *data, Rect screen, Vec2 offset, f32 thickness) {
+    static HMM_Vec3 *points, *verts;
+    static s32 *run_ends;
+    static s32 size;
+    if (data->n > size) {
+        size = data->n*2;
+        points = realloc(points, 2*size*sizeof(HMM_Vec3));
+        verts = realloc(verts, 4*size*sizeof(HMM_Vec3));
+        run_ends = realloc(run_ends, size*sizeof(s32));
+    }
+
+    Rect v = data->view;
+    s32 runs;
+    s32 n = clip_polyline(data->x, data->y, 0, 1, data->n, HMM_V3(v.x, v.y, -1), HMM_V3(v.x + v.w, v.y + v.h, 1),
+                          points, run_ends, &runs);
+    for (s32 i = 0; i < n; i++) {
+        Vec2 p = view_to_screen_raw(v, screen, (Vec2){points[i].X, points[i].Y});
+        points[i] = HMM_V3(p.x + offset.x, p.y + offset.y, 0);
+    }
+
+    flush();
+    glScissor(screen.x, height - (screen.y + screen.h), screen.w, screen.h);
+    for (s32 r = 0, first = 0; r < runs; first = run_ends[r++]) {
+        s32 count = tessellate_polyline(points + first, run_ends[r] - first, HMM_V3(0, 0, 1), thickness, verts);
+        r_draw_strip(verts, count, PCAST(mu_Color, data->color));
+    }
+    flush();
+    glScissor(0, 0, width, height);
+}
+
+/* Draws a series from its gpu copy, panning and zooming only changes the matrix. offset is
+   a late pan in pixels. Returns 0 if vertex buffers aren't available. */
+int r_draw_series(Data *data, Rect screen, Vec2 offset) {
+    if (!r_glGenBuffers || !r_glBindBuffer || !r_glBufferData || !r_glBufferSubData) { return 0; }
+    flush();
+
+    SeriesCache *cache = series_upload(data);
+    if (!cache) { r_glBindBuffer(GL_ARRAY_BUFFER, 0); return 0; }
+
+    glViewport(0, 0, width, height);
+    glScissor(screen.x, height - (screen.y + screen.h), screen.w, screen.h);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0.0f, width, height, 0.0f, -1.0f, +1.0f);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    if (imp->first_plot) {
+        glLoadMatrixf(imp->first_plot->camera.Elements[0]);
+    } else {
+        glLoadIdentity();
+    }
+    glTranslatef(offset.x, offset.y, 0);
+    glMultMatrixf(view_to_screen_matrix(data->view, screen).Elements[0]);
+
+    glDisable(GL_TEXTURE_2D);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glColor4ub(data->color.r, data->color.g, data->color.b, data->color.a);
+    glVertexPointer(2, GL_FLOAT, 0, 0);
+
+    if (data->flags & IMP_DATA_LINES) {
+        glDrawArrays(GL_LINE_STRIP, 0, data->n);
+    }
+    if (data->flags & IMP_DATA_MARKERS) {
+        glPointSize(2);
+        glDrawArrays(GL_POINTS, 0, data->n);
+    }
+
+    r_glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glEnable(GL_TEXTURE_2D);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glScissor(0, 0, width, height);
+    return 1;
 }
 
 
@@ -500,6 +928,25 @@ void r_draw_text(const char *text, mu_Vec2 pos, mu_Color color) {
 }
 
 
+/* Glyphs are drawn 1:1 from the atlas, so clipping their quads cuts the same pixels off src */
+void r_draw_text_clipped(const char *text, mu_Vec2 pos, mu_Color color, Rect clip) {
+    int cx0 = clip.x, cy0 = clip.y, cx1 = clip.x + clip.w, cy1 = clip.y + clip.h;
+    int x = pos.x;
+    for (const char *p = text; *p; p++) {
+        if ((*p & 0xc0) == 0x80) { continue; }
+        int chr = mu_min((unsigned char) *p, 127);
+        mu_Rect src = atlas[ATLAS_FONT + chr];
+        int x0 = mu_max(x, cx0), y0 = mu_max(pos.y, cy0);
+        int x1 = mu_min(x + src.w, cx1), y1 = mu_min(pos.y + src.h, cy1);
+        if (x0 < x1 && y0 < y1) {
+            mu_Rect dst = mu_rect(x0, y0, x1 - x0, y1 - y0);
+            push_quad(dst, mu_rect(src.x + x0 - x, src.y + y0 - pos.y, dst.w, dst.h), color);
+        }
+        x += src.w;
+    }
+}
+
+
 void r_draw_icon(int id, mu_Rect rect, mu_Color color) {
     mu_Rect src = atlas[id];
     int x = rect.x + (rect.w - src.w) / 2;